@@ -0,0 +1,292 @@
+/* arena_test.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  replays synthetic Lua allocation traces through arena_luaAlloc as a normal linux program (`make arena-test`).
+  every block is filled with a pattern that's checked when it's resized or freed, so overlapping or lost blocks show up.
+  the kernel's page & heap allocators are stood in for by malloc, and can be made to fail.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "heap.h"
+#include "memory_manager.h"
+#include "frame_allocator.h"
+
+// --- the kernel functions arena.c uses ---
+
+#define PAGE_SIZE 4096
+#define MAX_PAGE_BLOCKS 4096
+
+static struct {
+    void* address;
+    uint64_t pages;
+} page_blocks[MAX_PAGE_BLOCKS];
+static int page_block_count;
+static int fail_pages;      // memory_allocatePages returns 0 while this is set
+static int heap_objects;
+static int failures;
+
+static void check(int condition, char* what) {
+    if(!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+void memzero(void* address, size_t length) {
+    memset(address, 0, length);
+}
+
+void* kmalloc(size_t size) {
+    heap_objects++;
+    return malloc(size);
+}
+void kfree(void* object) {
+    heap_objects--;
+    free(object);
+}
+
+uint8_t* phys_base; // frame_allocator.c is linked in for frame_orderFor
+
+// rounded up to a power of two pages like the real one, arena.c counts on that for growing large blocks in place
+void* memory_allocatePages(uint64_t count) {
+    if(fail_pages || page_block_count == MAX_PAGE_BLOCKS) return 0;
+    uint64_t pages = 1ull << frame_orderFor(count);
+    void* address = aligned_alloc(PAGE_SIZE, pages * PAGE_SIZE);
+    if(!address) return 0;
+    page_blocks[page_block_count].address = address;
+    page_blocks[page_block_count].pages = pages;
+    page_block_count++;
+    return address;
+}
+
+uint64_t memory_freePages(void* address) {
+    for(int i = 0; i < page_block_count; i++) {
+        if(page_blocks[i].address != address) continue;
+        uint64_t pages = page_blocks[i].pages;
+        page_blocks[i] = page_blocks[--page_block_count];
+        free(address);
+        return pages;
+    }
+    check(0, "freed pages that weren't allocated (or were freed twice)");
+    return 0;
+}
+
+// --- blocks the trace has live, and the pattern each one should hold ---
+
+#define SLOTS 512
+
+typedef struct {
+    uint8_t* pointer;
+    size_t size;
+    uint8_t pattern;
+} slot;
+
+static slot slots[SLOTS];
+static uint64_t random_state = 0x2545f4914f6cdd1d;
+
+static uint64_t next_random() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+    return random_state;
+}
+
+// roughly what a Lua state asks for: mostly small strings, closures & table parts, sometimes a big array
+static size_t random_size() {
+    uint64_t roll = next_random() % 100;
+    if(roll < 70) return 1 + next_random() % 128;
+    if(roll < 95) return 129 + next_random() % 1920;
+    return 2049 + next_random() % 40000;
+}
+
+static void fill(slot* s) {
+    for(size_t i = 0; i < s->size; i++) {
+        s->pointer[i] = (uint8_t) (s->pattern + i);
+    }
+}
+
+static int holds_pattern(slot* s, size_t length) {
+    for(size_t i = 0; i < length; i++) {
+        if(s->pointer[i] != (uint8_t) (s->pattern + i)) return 0;
+    }
+    return 1;
+}
+
+static void trace_alloc(arena* a, slot* s, size_t size) {
+    // when ptr is 0, Lua passes the type of the new object as osize
+    s->pointer = arena_luaAlloc(a, 0, next_random() % 9, size);
+    check(s->pointer != 0, "allocation failed with memory available");
+    s->size = size;
+    s->pattern = next_random();
+    if(s->pointer) fill(s);
+}
+
+static void trace_realloc(arena* a, slot* s, size_t size) {
+    uint8_t* moved = arena_luaAlloc(a, s->pointer, s->size, size);
+    check(moved != 0, "realloc failed with memory available");
+    if(!moved) return;
+    s->pointer = moved;
+    check(holds_pattern(s, size < s->size ? size : s->size), "realloc lost the contents");
+    s->size = size;
+    fill(s);
+}
+
+static void trace_free(arena* a, slot* s) {
+    check(holds_pattern(s, s->size), "block was overwritten before it was freed");
+    check(arena_luaAlloc(a, s->pointer, s->size, 0) == 0, "free didn't return 0");
+    s->pointer = 0;
+}
+
+// --- the tests ---
+
+static void test_trace(int operations) {
+    arena* a = arena_create();
+    check(a != 0, "arena_create failed");
+    if(!a) return;
+    memset(slots, 0, sizeof(slots));
+
+    for(int i = 0; i < operations; i++) {
+        slot* s = &slots[next_random() % SLOTS];
+        if(!s->pointer) {
+            trace_alloc(a, s, random_size());
+        } else if(next_random() % 2) {
+            // tables & buffers mostly double (up to 64 KiB here) or halve, strings get built up a little at a time
+            uint64_t kind = next_random() % 3;
+            if(kind == 0 && s->size > 65536) kind = 1;
+            size_t size = kind == 0 ? s->size * 2 : kind == 1 ? (s->size + 1) / 2 : s->size + 1 + next_random() % 64;
+            trace_realloc(a, s, size);
+        } else {
+            trace_free(a, s);
+        }
+    }
+
+    arena_stats stats;
+    arena_getStats(a, &stats);
+    printf("trace: %d operations, %lu chunks, peak %lu KiB, %lu in place & %lu moved reallocs\n", operations,
+        stats.chunks, stats.peak_bytes / 1024, stats.in_place_reallocs, stats.moved_reallocs);
+    check(stats.in_place_reallocs > 0, "no realloc was done in place");
+
+    // free half, then destroy the arena with the rest still live
+    for(int i = 0; i < SLOTS; i += 2) {
+        if(slots[i].pointer) trace_free(a, &slots[i]);
+    }
+    for(int i = 1; i < SLOTS; i += 2) {
+        check(!slots[i].pointer || holds_pattern(&slots[i], slots[i].size), "live block was overwritten");
+    }
+    arena_destroy(a);
+    check(page_block_count == 0, "arena_destroy didn't free every chunk & large block");
+    check(heap_objects == 0, "arena_destroy didn't free the arena");
+}
+
+static void test_in_place() {
+    arena* a = arena_create();
+    if(!a) return;
+    arena_stats stats;
+
+    slot s = { 0 };
+    trace_alloc(a, &s, 33);
+    uint8_t* first = s.pointer;
+    trace_realloc(a, &s, 48);
+    check(s.pointer == first, "realloc within a size class moved");
+    trace_realloc(a, &s, 400);
+    check(s.pointer == first, "the newest object didn't grow into the rest of its chunk");
+    trace_realloc(a, &s, 20);
+    check(s.pointer == first, "the newest object didn't shrink in place");
+
+    slot large = { 0 };
+    trace_alloc(a, &large, 5000); // 2 pages
+    first = large.pointer;
+    trace_realloc(a, &large, 8000);
+    check(large.pointer == first, "large block didn't grow into its rounded up pages");
+    trace_realloc(a, &large, 3000);
+    check(large.pointer == first, "large block didn't shrink in place");
+    trace_realloc(a, &large, 20000);
+    check(large.pointer != first, "large block grew past its pages without moving");
+
+    trace_free(a, &s);
+    trace_free(a, &large);
+    arena_getStats(a, &stats);
+    check(stats.used_bytes == 0, "used bytes don't go back to 0 once everything is freed");
+    check(stats.large_blocks == 0, "large blocks are still counted after being freed");
+    arena_destroy(a);
+    check(page_block_count == 0 && heap_objects == 0, "arena_destroy leaked");
+}
+
+static void test_shrink_never_fails() {
+    arena* a = arena_create();
+    if(!a) return;
+
+    arena_stats stats;
+    slot large = { 0 };
+    slot small = { 0 };
+    slot filler = { 0 };
+    trace_alloc(a, &large, 30000);
+    arena_getStats(a, &stats);
+    uint64_t large_used = stats.used_bytes; // its whole rounded up pages
+    trace_alloc(a, &small, 2000);
+    trace_alloc(a, &filler, 16); // so small isn't the newest object & can't shrink into the chunk
+
+    // use up the chunk, so any allocation from here on needs pages that aren't there
+    fail_pages = 1;
+    while(arena_luaAlloc(a, 0, 0, 16));
+    arena_getStats(a, &stats);
+    uint64_t used_before = stats.used_bytes;
+
+    uint8_t* before = large.pointer;
+    uint8_t* shrunk = arena_luaAlloc(a, large.pointer, large.size, 100);
+    check(shrunk == before, "shrinking a large block to a small one failed without memory");
+    if(shrunk) {
+        check(holds_pattern(&large, 100), "shrinking without memory lost the contents");
+        large.size = 100;
+    }
+    arena_getStats(a, &stats);
+    check(stats.large_blocks == 0, "a large block shrunk without moving is still counted as large");
+
+    before = small.pointer;
+    shrunk = arena_luaAlloc(a, small.pointer, small.size, 100);
+    check(shrunk == before, "shrinking a small block to a smaller class failed without memory");
+    if(shrunk) {
+        check(holds_pattern(&small, 100), "shrinking without memory lost the contents");
+        small.size = 100;
+    }
+    arena_getStats(a, &stats);
+    check(stats.used_bytes == used_before - large_used - 2048 + 2 * 112, "blocks shrunk without moving aren't counted at their new size");
+
+    check(arena_luaAlloc(a, filler.pointer, filler.size, 5000) == 0, "growing succeeded without memory");
+    check(holds_pattern(&filler, filler.size), "a failed realloc changed the block");
+    fail_pages = 0;
+
+    // the shrunk blocks are freed with their new size, into a free list that fits in them
+    trace_free(a, &large);
+    trace_free(a, &small);
+    trace_free(a, &filler);
+    arena_getStats(a, &stats);
+    check(stats.used_bytes == used_before - large_used - 2048 - 16, "freeing the shrunk blocks got the used bytes wrong");
+    arena_destroy(a);
+    check(page_block_count == 0 && heap_objects == 0, "arena_destroy leaked after allocations failed");
+}
+
+int main() {
+    test_trace(200000);
+    test_in_place();
+    test_shrink_never_fails();
+    if(failures) {
+        printf("arena: %d checks failed\n", failures);
+        return 1;
+    }
+    printf("arena: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,314 @@
+/* bench.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  runs the page table builder, frame allocator & terminal renderer as a normal linux program (`make bench`).
+  physical memory is a big MAP_NORESERVE reservation (see phys.h), so only the pages that are actually touched cost anything.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "phys.h"
+#include "frame_allocator.h"
+#include "paging.h"
+#include "term.h"
+#include "serial.h"
+
+uint8_t* phys_base;
+
+// the kernel gets these from mem.c & serial.c
+void memzero(void* address, size_t length) {
+    memset(address, 0, length);
+}
+int serial_present() {
+    return 0;
+}
+int serial_write(const char* data, uint64_t length) {
+    (void) data;
+    return length;
+}
+
+static double seconds_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// --- synthetic UEFI memory maps ---
+
+enum {
+    EfiReservedMemoryType = 0,
+    EfiLoaderCode = 1,
+    EfiLoaderData = 2,
+    EfiBootServicesCode = 3,
+    EfiBootServicesData = 4,
+    EfiConventionalMemory = 7,
+    EfiACPIReclaimMemory = 9,
+    EfiACPIMemoryNVS = 10,
+};
+
+typedef struct {
+    uint32_t type;
+    uint64_t address;
+    uint64_t page_count;
+} region;
+
+#define MAX_REGIONS 4096
+static region regions[MAX_REGIONS];
+static int region_count;
+
+static uint32_t random_state = 0x1234567;
+static uint32_t random_next() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static void add_region(uint32_t type, uint64_t address, uint64_t size) {
+    if(region_count == MAX_REGIONS || size == 0) return;
+    regions[region_count++] = (region) { type, address, size / PAGE_SIZE };
+}
+
+// fills [begin, end) with conventional memory, broken up by `pieces` small firmware allocations
+static void add_fragmented(uint64_t begin, uint64_t end, int pieces) {
+    static const uint32_t firmware_types[] = {
+        EfiBootServicesCode, EfiBootServicesData, EfiLoaderData, EfiACPIReclaimMemory, EfiACPIMemoryNVS
+    };
+    uint64_t step = (end - begin) / (pieces + 1);
+    uint64_t address = begin;
+    for(int i = 0; i < pieces; i++) {
+        uint64_t hole = address + (step & ~(uint64_t)(PAGE_SIZE - 1));
+        uint64_t hole_size = (1 + random_next() % 64) * PAGE_SIZE;
+        add_region(EfiConventionalMemory, address, hole - address);
+        add_region(firmware_types[random_next() % 5], hole, hole_size);
+        address = hole + hole_size;
+    }
+    add_region(EfiConventionalMemory, address, end - address);
+}
+
+static void build_qemu_map() { // like OVMF with -m 512M
+    region_count = 0;
+    add_region(EfiConventionalMemory, 0, 0xa0000);
+    add_region(EfiConventionalMemory, 0x100000, 0x700000);
+    add_region(EfiACPIMemoryNVS, 0x800000, 0x8000);
+    add_fragmented(0x808000, 0x1f000000, 40);
+    add_region(EfiReservedMemoryType, 0x1f000000, 0x1000000);
+}
+
+static void build_desktop_map() { // 16 GiB, with the usual 32-bit MMIO hole
+    region_count = 0;
+    add_region(EfiConventionalMemory, 0x1000, 0x9f000);
+    add_fragmented(0x100000, 0xb0000000, 150);
+    add_region(EfiReservedMemoryType, 0xb0000000, 0x10000000);
+    add_fragmented(0x100000000, 0x440000000, 20);
+}
+
+static void build_server_map() { // 256 GiB over two nodes, mostly big clean ranges
+    region_count = 0;
+    add_region(EfiConventionalMemory, 0x1000, 0x9f000);
+    add_fragmented(0x100000, 0x80000000, 60);
+    add_region(EfiReservedMemoryType, 0x80000000, 0x80000000);
+    add_fragmented(0x100000000, 0x2000000000, 8);
+    add_fragmented(0x2000000000, 0x4080000000, 8);
+}
+
+// --- page tables & frame allocator ---
+
+static int is_usable(uint32_t type) {
+    return type == EfiConventionalMemory || type == EfiLoaderCode || type == EfiLoaderData
+        || type == EfiBootServicesCode || type == EfiBootServicesData;
+}
+
+static uint64_t map_end() {
+    uint64_t end = 0;
+    for(int i = 0; i < region_count; i++) {
+        uint64_t region_end = regions[i].address + regions[i].page_count * PAGE_SIZE;
+        if(region_end > end) end = region_end;
+    }
+    return end;
+}
+
+// same steps as memory_init: metadata in the first conventional region that fits, then every conventional region
+static void setup_frames() {
+    uint64_t usable_begin = -1;
+    uint64_t usable_end = 0;
+    for(int i = 0; i < region_count; i++) {
+        if(!is_usable(regions[i].type)) continue;
+        uint64_t end = regions[i].address + regions[i].page_count * PAGE_SIZE;
+        if(regions[i].address < usable_begin) usable_begin = regions[i].address;
+        if(end > usable_end) usable_end = end;
+    }
+    uint64_t metadata_pages = (frame_metadataSize(usable_begin, usable_end) + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t metadata_address = 0;
+    for(int i = 0; i < region_count; i++) {
+        if(regions[i].type == EfiConventionalMemory && regions[i].address && regions[i].page_count >= metadata_pages) {
+            metadata_address = regions[i].address;
+            break;
+        }
+    }
+    frame_init(phys_to_virt(metadata_address), usable_begin, usable_end);
+    for(int i = 0; i < region_count; i++) {
+        if(regions[i].type != EfiConventionalMemory) continue;
+        uint64_t start = regions[i].address;
+        uint64_t end = start + regions[i].page_count * PAGE_SIZE;
+        if(start == metadata_address) start += metadata_pages * PAGE_SIZE;
+        frame_addRegion(start, (end - start) / PAGE_SIZE);
+    }
+}
+
+static uint64_t pml4[PAGE_TABLE_ENTRY_COUNT];
+
+// returns how many bytes were mapped
+static uint64_t map_everything() {
+    uint64_t mapped = 0;
+    uint64_t run_begin = 0;
+    uint64_t run_end = 0;
+    for(int i = 0; i < region_count; i++) {
+        if(regions[i].address != run_end) {
+            paging_identityMap(pml4, run_begin, run_end, MEMORY_CACHE_WRITE_BACK);
+            mapped += run_end - run_begin;
+            run_begin = regions[i].address;
+        }
+        run_end = regions[i].address + regions[i].page_count * PAGE_SIZE;
+    }
+    paging_identityMap(pml4, run_begin, run_end, MEMORY_CACHE_WRITE_BACK);
+    mapped += run_end - run_begin;
+    // a 1920x1080 framebuffer just above the 32-bit hole's start, like most firmware puts it
+    paging_identityMap(pml4, 0xc0000000, 0xc0000000 + 1920 * 1080 * 4, MEMORY_CACHE_WRITE_COMBINING);
+    return mapped + 1920 * 1080 * 4;
+}
+
+#define FRAME_BATCH 65536
+
+static void bench_map(char* name, void (*build)()) {
+    build();
+    uint64_t memory_size = map_end();
+    uint64_t size = memory_size;
+    if(size < 0xc0000000 + 1920 * 1080 * 4) size = 0xc0000000 + 1920 * 1080 * 4;
+    phys_base = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(phys_base == MAP_FAILED) {
+        printf("%s: couldn't reserve %lu MiB of fake physical memory\n", name, size >> 20);
+        return;
+    }
+    printf("%s: %d descriptors, %lu MiB\n", name, region_count, memory_size >> 20);
+
+    static const struct { char* name; int has_2m, has_1g; } modes[] = {
+        { "4K only", 0, 0 }, { "2M", 1, 0 }, { "2M+1G", 1, 1 }
+    };
+    for(int mode = 0; mode < 3; mode++) {
+        int iterations = 0;
+        uint64_t mapped = 0;
+        double elapsed = 0;
+        paging_stats stats;
+        // 4 KiB only is slow for big maps, so run each mode for about the same time instead of the same count
+        while(elapsed < 0.5 && iterations < 1000) {
+            setup_frames();
+            memset(pml4, 0, sizeof(pml4));
+            paging_init(modes[mode].has_2m, modes[mode].has_1g, 1);
+            double start = seconds_now();
+            mapped += map_everything();
+            elapsed += seconds_now() - start;
+            stats = *paging_getStats();
+            iterations++;
+        }
+        uint64_t tables = 1 + stats.pdp_tables + stats.pd_tables + stats.page_tables;
+        printf("  %-8s %8.1f us/map, %10.0f M pages/s, %6lu KiB of tables (%lu pdp, %lu pd, %lu pt)\n",
+            modes[mode].name, elapsed / iterations * 1e6, mapped / PAGE_SIZE / elapsed / 1e6,
+            tables * PAGE_SIZE / 1024, stats.pdp_tables, stats.pd_tables, stats.page_tables);
+    }
+
+    // single frames like the per-cpu caches refill with, then freed in a scrambled order so the buddies merge late
+    setup_frames();
+    static uint64_t frames[FRAME_BATCH];
+    int count = 0;
+    double start = seconds_now();
+    for(int round = 0; round < 16; round++) {
+        for(count = 0; count < FRAME_BATCH; count++) {
+            frames[count] = frame_allocate(0);
+            if(!frames[count]) break;
+        }
+        for(int i = count - 1; i > 0; i--) {
+            int j = random_next() % (i + 1);
+            uint64_t swap = frames[i];
+            frames[i] = frames[j];
+            frames[j] = swap;
+        }
+        for(int i = 0; i < count; i++) frame_free(frames[i]);
+    }
+    double elapsed = seconds_now() - start;
+    printf("  frames   %8.1f M allocate+free/s\n", 16.0 * count / elapsed / 1e6);
+
+    munmap(phys_base, size);
+}
+
+// --- terminal ---
+
+#define SCREEN_WIDTH 1920
+#define SCREEN_HEIGHT 1080
+#define TERM_ROUND_LINES 100
+
+// flush_on_write is how the kernel runs before any cpu drains the log, without it writes only flush every few ms
+static void bench_term(char* name, int back_buffer, int flush_on_write) {
+    uint32_t* framebuffer = calloc(SCREEN_WIDTH * SCREEN_HEIGHT, 4);
+    term_init(framebuffer, SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_WIDTH);
+    void* buffer = 0;
+    if(back_buffer) {
+        buffer = calloc(1, term_backBufferSize());
+        term_setBackBuffer(buffer);
+    }
+    term_setFlushOnWrite(flush_on_write);
+    char line[81];
+    for(int i = 0; i < 79; i++) line[i] = ' ' + i % 95;
+    line[79] = '\n';
+    line[80] = 0;
+
+    uint64_t glyphs = 0;
+    double start = seconds_now();
+    double elapsed = 0;
+    while(elapsed < 0.5) {
+        for(int i = 0; i < TERM_ROUND_LINES; i++) term_write(line); // a line per call, like kprintf
+        glyphs += 80 * TERM_ROUND_LINES;
+        elapsed = seconds_now() - start;
+    }
+    term_flush(); // so everything written has reached the framebuffer. nothing to do without a back buffer
+    elapsed = seconds_now() - start;
+    printf("%s: %.1f M glyphs/s\n", name, glyphs / elapsed / 1e6);
+
+    if(back_buffer && !flush_on_write) { // scrolling the view redraws every cell of the screen from the text
+        int redraws = 0;
+        start = seconds_now();
+        elapsed = 0;
+        while(elapsed < 0.5) {
+            term_scroll(1);
+            term_scroll(-1);
+            redraws += 2;
+            elapsed = seconds_now() - start;
+        }
+        printf("%s: %.0f full screen redraws/s\n", name, redraws / elapsed);
+    }
+    free(buffer);
+    free(framebuffer);
+}
+
+int main() {
+    bench_map("qemu 512M", build_qemu_map);
+    bench_map("desktop 16G", build_desktop_map);
+    bench_map("server 256G", build_server_map);
+    bench_term("term direct", 0, 1);
+    bench_term("term back buffer, flushing every write", 1, 1);
+    bench_term("term back buffer, flushing every few ms", 1, 0);
+    return 0;
+}
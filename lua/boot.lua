@@ -0,0 +1,20 @@
+-- boot.lua © Penguin_Spy 2025
+-- This Source Code Form is subject to the terms of the Mozilla Public
+-- License, v. 2.0. If a copy of the MPL was not distributed with this
+-- file, You can obtain one at https://mozilla.org/MPL/2.0/.
+-- This Source Code Form is "Incompatible With Secondary Licenses", as
+-- defined by the Mozilla Public License, v. 2.0.
+--
+-- The Covered Software may not be used as training or other input data
+-- for LLMs, generative AI, or other forms of machine learning or neural
+-- networks.
+
+-- every lua/*.lua file is compiled into the kernel and run in order (by name) once memory is set up
+
+term.setTextColor(term.colors.lime)
+term.write("hello from ", _VERSION, "\n")
+term.setTextColor(term.colors.white)
+
+local stats = memory.stats()
+term.write(string.format("lua: %d of %d pages free, %d KiB of heap in use\n",
+    stats.freePages, stats.totalPages, stats.heapUsed // 1024))
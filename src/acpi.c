@@ -0,0 +1,76 @@
+/* acpi.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "mem.h"
+#include "acpi.h"
+
+typedef struct __attribute__((packed)) {
+    char signature[8];          // "RSD PTR "
+    uint8_t checksum;           // of the first 20 bytes (the ACPI 1.0 part)
+    char oem_id[6];
+    uint8_t revision;           // 0 for ACPI 1.0, 2 for everything after
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;  // of the whole structure
+    uint8_t reserved[3];
+} acpi_rsdp;
+
+// the root table is a header followed by 32-bit (RSDT) or 64-bit (XSDT) table addresses
+static acpi_header* root_table;
+static int root_entry_size;
+
+// every ACPI structure sums to 0 mod 256
+static int checksum_ok(void* data, uint64_t length) {
+    uint8_t sum = 0;
+    for(uint64_t i = 0; i < length; i++) {
+        sum += ((uint8_t*) data)[i];
+    }
+    return sum == 0;
+}
+
+int acpi_init(void* rsdp_pointer) {
+    acpi_rsdp* rsdp = rsdp_pointer;
+    if(!rsdp || memcmp(rsdp->signature, "RSD PTR ", 8) != 0 || !checksum_ok(rsdp, 20)) return 0;
+
+    if(rsdp->revision >= 2 && rsdp->xsdt_address && checksum_ok(rsdp, rsdp->length)) {
+        root_table = (acpi_header*) rsdp->xsdt_address;
+        root_entry_size = 8;
+    } else {
+        root_table = (acpi_header*) (uint64_t) rsdp->rsdt_address;
+        root_entry_size = 4;
+    }
+    if(!checksum_ok(root_table, root_table->length)) {
+        root_table = 0;
+        return 0;
+    }
+    return 1;
+}
+
+acpi_header* acpi_findTable(char* signature) {
+    if(!root_table) return 0;
+
+    uint8_t* entries = (uint8_t*) (root_table + 1);
+    uint64_t count = (root_table->length - sizeof(acpi_header)) / root_entry_size;
+    for(uint64_t i = 0; i < count; i++) {
+        // the entries aren't necessarily aligned, so copy them out
+        uint64_t address = 0;
+        memcpy(&address, &entries[i * root_entry_size], root_entry_size);
+        acpi_header* table = (acpi_header*) address;
+        if(table && memcmp(table->signature, signature, 4) == 0 && checksum_ok(table, table->length)) {
+            return table;
+        }
+    }
+    return 0;
+}
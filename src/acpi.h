@@ -0,0 +1,38 @@
+/* acpi.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  finds ACPI tables through the root pointer the loader got from the firmware.
+  the tables are in ACPI reclaim memory, which stays identity mapped
+ */
+
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+
+typedef struct __attribute__((packed)) {
+    char signature[4];
+    uint32_t length;            // of the whole table, including this header
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} acpi_header;
+
+// returns whether the root pointer and root table are valid
+int acpi_init(void* rsdp);
+// returns the first table with a signature like "APIC", or 0 if there isn't one
+acpi_header* acpi_findTable(char* signature);
+
+#endif
@@ -0,0 +1,228 @@
+/* apic.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "acpi.h"
+#include "memory_manager.h"
+#include "apic.h"
+
+#define MSR_IA32_APIC_BASE 0x1B
+#define APIC_BASE_X2APIC (1 << 10)
+#define MSR_X2APIC_BASE 0x800   // x2APIC register n is MSR 0x800 + (xAPIC offset >> 4)
+
+// register offsets, in the xAPIC MMIO page
+#define APIC_ID         0x020
+#define APIC_EOI        0x0B0
+#define APIC_SPURIOUS   0x0F0
+#define APIC_ICR_LOW    0x300
+#define APIC_ICR_HIGH   0x310
+
+#define APIC_SPURIOUS_ENABLE (1 << 8)
+#define APIC_SPURIOUS_VECTOR 0xFF
+#define APIC_ICR_PENDING     (1 << 12)
+#define APIC_ICR_INIT        (5 << 8)
+#define APIC_ICR_STARTUP     (6 << 8)
+#define APIC_ICR_ASSERT      (1 << 14)
+
+typedef struct __attribute__((packed)) {
+    acpi_header header;
+    uint32_t local_apic_address;
+    uint32_t flags;
+    uint8_t entries[];          // each starts with a type & length byte
+} acpi_madt;
+
+#define MADT_LOCAL_APIC          0
+#define MADT_IO_APIC             1
+#define MADT_SOURCE_OVERRIDE     2
+#define MADT_LOCAL_APIC_OVERRIDE 5
+#define MADT_LOCAL_X2APIC        9
+#define MADT_PROCESSOR_ENABLED   (1 << 0)
+
+static volatile uint32_t* local_apic;
+static int x2apic;
+static uint32_t processor_ids[APIC_MAX_CPUS];
+static int processor_count;
+
+// IO APIC registers are read & written through a select register and a window register
+#define IO_APIC_SELECT  0x00
+#define IO_APIC_WINDOW  0x10
+#define IO_APIC_VERSION 0x01
+#define IO_APIC_REDIRECTION(n) (0x10 + (n) * 2)
+
+#define REDIRECTION_ACTIVE_LOW (1 << 13)
+#define REDIRECTION_LEVEL      (1 << 15)
+
+// MADT source override flags
+#define OVERRIDE_POLARITY_MASK 0x3
+#define OVERRIDE_ACTIVE_LOW    0x3
+#define OVERRIDE_TRIGGER_MASK  0xC
+#define OVERRIDE_LEVEL         0xC
+
+#define MAX_IO_APICS 8
+static struct {
+    volatile uint32_t* registers;
+    uint32_t gsi_base;
+    uint32_t gsi_count;
+} io_apics[MAX_IO_APICS];
+static int io_apic_count;
+
+// where each ISA irq is connected. without an override it's the same numbered GSI, edge triggered & active high
+static struct {
+    uint32_t gsi;
+    uint16_t flags;
+} isa_irqs[16];
+
+static uint32_t read_register(uint32_t offset) {
+    if(x2apic) return cpu_readMsr(MSR_X2APIC_BASE + (offset >> 4));
+    return local_apic[offset / 4];
+}
+
+static void write_register(uint32_t offset, uint32_t value) {
+    if(x2apic) {
+        cpu_writeMsr(MSR_X2APIC_BASE + (offset >> 4), value);
+    } else {
+        local_apic[offset / 4] = value;
+    }
+}
+
+static uint32_t read_io_apic(int index, uint32_t reg) {
+    io_apics[index].registers[IO_APIC_SELECT / 4] = reg;
+    return io_apics[index].registers[IO_APIC_WINDOW / 4];
+}
+
+static void write_io_apic(int index, uint32_t reg, uint32_t value) {
+    io_apics[index].registers[IO_APIC_SELECT / 4] = reg;
+    io_apics[index].registers[IO_APIC_WINDOW / 4] = value;
+}
+
+static void add_processor(uint32_t apic_id, uint32_t flags) {
+    if(!(flags & MADT_PROCESSOR_ENABLED) || processor_count >= APIC_MAX_CPUS) return;
+    for(int i = 0; i < processor_count; i++) { // firmware can list a cpu as both kinds of entry
+        if(processor_ids[i] == apic_id) return;
+    }
+    processor_ids[processor_count++] = apic_id;
+}
+
+int apic_init() {
+    acpi_madt* madt = (acpi_madt*) acpi_findTable("APIC");
+    if(!madt) return 0;
+
+    for(uint32_t irq = 0; irq < 16; irq++) {
+        isa_irqs[irq].gsi = irq;
+        isa_irqs[irq].flags = 0;
+    }
+
+    uint64_t address = madt->local_apic_address;
+    uint8_t* entry = madt->entries;
+    uint8_t* end = (uint8_t*) madt + madt->header.length;
+    while(entry + 2 <= end && entry[1] >= 2) {
+        switch(entry[0]) {
+            case MADT_LOCAL_APIC:           // u8 acpi id, u8 apic id, u32 flags
+                add_processor(entry[3], *(uint32_t*) &entry[4]);
+                break;
+            case MADT_LOCAL_X2APIC:         // u16 reserved, u32 x2apic id, u32 flags, u32 acpi id
+                add_processor(*(uint32_t*) &entry[4], *(uint32_t*) &entry[8]);
+                break;
+            case MADT_IO_APIC:              // u8 id, u8 reserved, u32 address, u32 first GSI
+                if(io_apic_count < MAX_IO_APICS) {
+                    io_apics[io_apic_count].registers = (volatile uint32_t*) (uint64_t) *(uint32_t*) &entry[4];
+                    io_apics[io_apic_count].gsi_base = *(uint32_t*) &entry[8];
+                    io_apic_count++;
+                }
+                break;
+            case MADT_SOURCE_OVERRIDE:      // u8 bus, u8 irq, u32 GSI, u16 flags
+                if(entry[3] < 16) {
+                    isa_irqs[entry[3]].gsi = *(uint32_t*) &entry[4];
+                    isa_irqs[entry[3]].flags = *(uint16_t*) &entry[8];
+                }
+                break;
+            case MADT_LOCAL_APIC_OVERRIDE:  // u16 reserved, u64 address
+                address = *(uint64_t*) &entry[4];
+                break;
+        }
+        entry += entry[1];
+    }
+
+    x2apic = (cpu_readMsr(MSR_IA32_APIC_BASE) & APIC_BASE_X2APIC) != 0;
+    if(!x2apic) {
+        memory_mapMMIO(address, 4096, MEMORY_CACHE_UNCACHED);
+        local_apic = (volatile uint32_t*) address;
+    }
+    for(int i = 0; i < io_apic_count; i++) {
+        memory_mapMMIO((uint64_t) io_apics[i].registers, 4096, MEMORY_CACHE_UNCACHED);
+        // the version register also holds the highest redirection entry
+        io_apics[i].gsi_count = ((read_io_apic(i, IO_APIC_VERSION) >> 16) & 0xff) + 1;
+    }
+    apic_enableLocal();
+    return 1;
+}
+
+void apic_enableLocal() {
+    write_register(APIC_SPURIOUS, APIC_SPURIOUS_ENABLE | APIC_SPURIOUS_VECTOR);
+}
+
+uint32_t apic_localId() {
+    uint32_t id = read_register(APIC_ID);
+    return x2apic ? id : id >> 24;
+}
+
+int apic_processorCount() {
+    return processor_count;
+}
+uint32_t apic_processorId(int index) {
+    return processor_ids[index];
+}
+
+static void send_ipi(uint32_t apic_id, uint32_t command) {
+    if(x2apic) { // one 64-bit register, and the cpu doesn't report delivery anymore
+        cpu_writeMsr(MSR_X2APIC_BASE + (APIC_ICR_LOW >> 4), ((uint64_t) apic_id << 32) | command);
+        return;
+    }
+    write_register(APIC_ICR_HIGH, apic_id << 24);
+    write_register(APIC_ICR_LOW, command); // writing the low half sends it
+    while(read_register(APIC_ICR_LOW) & APIC_ICR_PENDING) {
+        cpu_pause();
+    }
+}
+
+void apic_sendInit(uint32_t apic_id) {
+    send_ipi(apic_id, APIC_ICR_INIT | APIC_ICR_ASSERT);
+}
+
+void apic_sendStartup(uint32_t apic_id, uint8_t vector) {
+    send_ipi(apic_id, APIC_ICR_STARTUP | APIC_ICR_ASSERT | vector);
+}
+
+void apic_eoi() {
+    write_register(APIC_EOI, 0);
+}
+
+int apic_routeIsaIrq(uint8_t irq, uint8_t vector, uint32_t apic_id) {
+    if(irq >= 16) return 0;
+    uint32_t gsi = isa_irqs[irq].gsi;
+    uint16_t flags = isa_irqs[irq].flags;
+
+    for(int i = 0; i < io_apic_count; i++) {
+        if(gsi < io_apics[i].gsi_base || gsi >= io_apics[i].gsi_base + io_apics[i].gsi_count) continue;
+        uint32_t entry = vector; // fixed delivery, physical destination, unmasked
+        if((flags & OVERRIDE_POLARITY_MASK) == OVERRIDE_ACTIVE_LOW) entry |= REDIRECTION_ACTIVE_LOW;
+        if((flags & OVERRIDE_TRIGGER_MASK) == OVERRIDE_LEVEL) entry |= REDIRECTION_LEVEL;
+        uint32_t pin = gsi - io_apics[i].gsi_base;
+        // the destination goes in first, so the entry doesn't fire at the wrong cpu while it's half written
+        write_io_apic(i, IO_APIC_REDIRECTION(pin) + 1, apic_id << 24);
+        write_io_apic(i, IO_APIC_REDIRECTION(pin), entry);
+        return 1;
+    }
+    return 0;
+}
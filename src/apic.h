@@ -0,0 +1,42 @@
+/* apic.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  local & IO APIC access, and the processor list from the ACPI MADT.
+  works with the local APIC in either xAPIC (MMIO) or x2APIC (MSR) mode, whichever the firmware left it in
+ */
+
+#ifndef APIC_H
+#define APIC_H
+
+#include <stdint.h>
+
+#define APIC_MAX_CPUS 64
+
+// parses the MADT, maps the local APIC and enables it on this cpu. returns 0 if there's no MADT
+int apic_init();
+// enables the local APIC of the calling cpu (apic_init does this for the bootstrap processor)
+void apic_enableLocal();
+
+uint32_t apic_localId();
+// enabled processors listed in the MADT, including the one calling this
+int apic_processorCount();
+uint32_t apic_processorId(int index);
+
+// acknowledges the interrupt being handled
+void apic_eoi();
+// sends an ISA irq (after any MADT override) to a vector on one cpu. returns 0 if no IO APIC has it
+int apic_routeIsaIrq(uint8_t irq, uint8_t vector, uint32_t apic_id);
+
+// inter-processor interrupts for starting the other cpus. both wait until the local APIC has sent them
+void apic_sendInit(uint32_t apic_id);
+void apic_sendStartup(uint32_t apic_id, uint8_t vector);
+
+#endif
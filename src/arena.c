@@ -0,0 +1,250 @@
+/* arena.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mem.h"
+#include "heap.h"
+#include "memory_manager.h"
+#include "frame_allocator.h"
+#include "arena.h"
+
+#define PAGE_SIZE 4096
+
+// small objects are 16 byte aligned (Lua's LUAI_MAXALIGN) and come from chunks of this many pages
+#define CHUNK_PAGES 16
+#define CHUNK_SIZE (CHUNK_PAGES * PAGE_SIZE)
+
+// most Lua objects are small & vary by a few words (strings, closures with n upvalues, tables, userdata),
+// so classes go up in steps of 16 bytes to 512, then in steps of half a power of two to 2048
+#define FINE_STEP 16
+#define FINE_LIMIT 512
+#define FINE_CLASSES (FINE_LIMIT / FINE_STEP)
+#define CLASS_COUNT (FINE_CLASSES + 4)
+#define SMALL_LIMIT 2048
+
+typedef struct chunk {
+    struct chunk* next;
+    uint8_t padding[8];
+} chunk;
+
+// anything bigger than SMALL_LIMIT gets its own pages, with this header in front
+typedef struct large_block {
+    struct large_block* next;
+    struct large_block* prev;
+    uint64_t capacity;          // bytes after the header
+    uint8_t padding[8];
+} large_block;
+
+struct arena {
+    void* free_lists[CLASS_COUNT];  // freed objects link through their first 8 bytes
+    uint8_t* bump;                  // unused part of the newest chunk
+    uint8_t* bump_end;
+    chunk* chunks;
+    large_block* large_blocks;
+    arena_stats stats;
+};
+
+static inline uint32_t class_for(size_t size) {
+    if(size <= FINE_LIMIT) return size == 0 ? 0 : (size - 1) / FINE_STEP;
+    if(size <= 768) return FINE_CLASSES;
+    if(size <= 1024) return FINE_CLASSES + 1;
+    if(size <= 1536) return FINE_CLASSES + 2;
+    return FINE_CLASSES + 3;
+}
+
+static inline uint64_t class_size(uint32_t index) {
+    static const uint16_t coarse_sizes[4] = { 768, 1024, 1536, 2048 };
+    if(index < FINE_CLASSES) return (index + 1) * FINE_STEP;
+    return coarse_sizes[index - FINE_CLASSES];
+}
+
+arena* arena_create() {
+    arena* a = kmalloc(sizeof(arena));
+    if(!a) return 0;
+    memzero(a, sizeof(arena));
+    return a;
+}
+
+void arena_destroy(arena* a) {
+    if(!a) return;
+    for(chunk* c = a->chunks; c;) {
+        chunk* next = c->next;
+        memory_freePages(c);
+        c = next;
+    }
+    for(large_block* block = a->large_blocks; block;) {
+        large_block* next = block->next;
+        memory_freePages(block);
+        block = next;
+    }
+    kfree(a);
+}
+
+static void count_used(arena* a, int64_t bytes) {
+    a->stats.used_bytes += bytes;
+    if(a->stats.used_bytes > a->stats.peak_bytes) {
+        a->stats.peak_bytes = a->stats.used_bytes;
+    }
+}
+
+static void* alloc_small(arena* a, uint32_t index) {
+    void* object = a->free_lists[index];
+    if(object) {
+        a->free_lists[index] = *(void**) object;
+    } else {
+        uint64_t size = class_size(index);
+        if(a->bump + size > a->bump_end) { // the rest of the current chunk is wasted, it's never more than 2 KiB
+            chunk* c = memory_allocatePages(CHUNK_PAGES);
+            if(!c) return 0;
+            c->next = a->chunks;
+            a->chunks = c;
+            a->stats.chunks++;
+            a->bump = (uint8_t*) c + sizeof(chunk);
+            a->bump_end = (uint8_t*) c + CHUNK_SIZE;
+        }
+        object = a->bump;
+        a->bump += size;
+    }
+    count_used(a, class_size(index));
+    return object;
+}
+
+static void free_small(arena* a, void* object, uint32_t index) {
+    if(a->bump == (uint8_t*) object + class_size(index)) { // the newest object, give it back to the chunk
+        a->bump = object;
+    } else {
+        *(void**) object = a->free_lists[index];
+        a->free_lists[index] = object;
+    }
+    count_used(a, -(int64_t) class_size(index));
+}
+
+static void* alloc_large(arena* a, size_t size) {
+    uint64_t pages = (size + sizeof(large_block) + PAGE_SIZE - 1) / PAGE_SIZE;
+    large_block* block = memory_allocatePages(pages);
+    if(!block) return 0;
+    // the memory manager rounds up to a power of two pages, so all of that is usable for growing in place
+    block->capacity = (PAGE_SIZE << frame_orderFor(pages)) - sizeof(large_block);
+    block->prev = 0;
+    block->next = a->large_blocks;
+    if(block->next) block->next->prev = block;
+    a->large_blocks = block;
+    a->stats.large_blocks++;
+    count_used(a, block->capacity);
+    return block + 1;
+}
+
+static void unlink_large(arena* a, large_block* block) {
+    if(block->prev) {
+        block->prev->next = block->next;
+    } else {
+        a->large_blocks = block->next;
+    }
+    if(block->next) block->next->prev = block->prev;
+    a->stats.large_blocks--;
+    count_used(a, -(int64_t) block->capacity);
+}
+
+static void free_large(arena* a, void* object) {
+    large_block* block = (large_block*) object - 1;
+    unlink_large(a, block);
+    memory_freePages(block);
+}
+
+static void* arena_alloc(arena* a, size_t size) {
+    a->stats.allocations++;
+    if(size > SMALL_LIMIT) return alloc_large(a, size);
+    return alloc_small(a, class_for(size));
+}
+
+static void arena_free(arena* a, void* object, size_t size) {
+    if(size > SMALL_LIMIT) {
+        free_large(a, object);
+    } else {
+        free_small(a, object, class_for(size));
+    }
+}
+
+// whether the object can become nsize bytes without moving
+static int resize_in_place(arena* a, void* object, size_t osize, size_t nsize) {
+    if(osize > SMALL_LIMIT) {
+        return nsize > SMALL_LIMIT && nsize <= ((large_block*) object - 1)->capacity;
+    }
+    if(nsize > SMALL_LIMIT) return 0;
+
+    uint32_t old_index = class_for(osize);
+    uint32_t new_index = class_for(nsize);
+    if(old_index == new_index) return 1;
+
+    // the newest object in the chunk can grow or shrink into the unused part
+    uint8_t* end = (uint8_t*) object + class_size(old_index);
+    uint8_t* new_end = (uint8_t*) object + class_size(new_index);
+    if(end == a->bump && new_end <= a->bump_end) {
+        a->bump = new_end;
+        count_used(a, (int64_t) class_size(new_index) - (int64_t) class_size(old_index));
+        return 1;
+    }
+    return 0;
+}
+
+// a shrink that couldn't move leaves the object where it is, but Lua frees it with nsize from now on,
+// so it's counted as an object of nsize's class. the rest of its space is wasted until the arena is destroyed
+static void keep_shrunk(arena* a, void* object, size_t osize, size_t nsize) {
+    uint32_t new_index = class_for(nsize);
+    if(osize > SMALL_LIMIT) { // large blocks only get here when nsize is small
+        // its pages go on the chunk list instead, so arena_destroy still frees them
+        large_block* block = (large_block*) object - 1;
+        unlink_large(a, block);
+        chunk* c = (chunk*) block;
+        c->next = a->chunks;
+        a->chunks = c;
+        a->stats.chunks++;
+        count_used(a, class_size(new_index));
+    } else {
+        count_used(a, (int64_t) class_size(new_index) - (int64_t) class_size(class_for(osize)));
+    }
+}
+
+void* arena_luaAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+    arena* a = ud;
+
+    if(nsize == 0) {
+        if(ptr) arena_free(a, ptr, osize);
+        return 0;
+    }
+    if(!ptr) { // osize is the type of the new object, not a size
+        return arena_alloc(a, nsize);
+    }
+
+    if(resize_in_place(a, ptr, osize, nsize)) {
+        a->stats.in_place_reallocs++;
+        return ptr;
+    }
+
+    void* moved = arena_alloc(a, nsize);
+    if(!moved) {
+        // Lua assumes shrinking can't fail
+        if(nsize > osize) return 0;
+        keep_shrunk(a, ptr, osize, nsize);
+        return ptr;
+    }
+    memcpy(moved, ptr, nsize < osize ? nsize : osize);
+    arena_free(a, ptr, osize);
+    a->stats.moved_reallocs++;
+    return moved;
+}
+
+void arena_getStats(arena* a, arena_stats* stats) {
+    *stats = a->stats;
+}
@@ -0,0 +1,46 @@
+/* arena.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  memory for one Lua state. small objects are carved out of big chunks and recycled through
+  per-size free lists, everything is given back at once when the state is closed.
+  arena_luaAlloc has the lua_Alloc signature, pass it to lua_newstate with the arena as ud.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct arena arena;
+
+typedef struct {
+    uint64_t used_bytes;        // rounded up to size classes
+    uint64_t peak_bytes;
+    uint64_t chunks;
+    uint64_t large_blocks;
+    uint64_t allocations;
+    uint64_t in_place_reallocs; // reallocs that didn't have to move
+    uint64_t moved_reallocs;
+} arena_stats;
+
+// returns 0 if out of memory
+arena* arena_create();
+// frees every chunk & large block of the arena, and the arena itself. call it after lua_close
+void arena_destroy(arena* arena);
+
+// lua_Alloc: frees when nsize is 0, allocates when ptr is 0, otherwise reallocs (in place if it can).
+// shrinking never fails, as Lua expects
+void* arena_luaAlloc(void* ud, void* ptr, size_t osize, size_t nsize);
+
+void arena_getStats(arena* arena, arena_stats* stats);
+
+#endif
@@ -0,0 +1,99 @@
+/* clock.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "clock.h"
+
+// the PIT always counts at this rate, no matter what the cpu is doing
+#define PIT_FREQUENCY 1193182
+#define PIT_CHANNEL_2 0x42
+#define PIT_COMMAND   0x43
+#define PIT_GATE      0x61    // bit 0: channel 2 gate, bit 1: speaker, bit 5: channel 2 output
+
+#define CALIBRATION_MS 10
+#define CALIBRATION_RUNS 3
+
+static uint64_t tsc_frequency;
+static uint64_t tsc_start;
+static int tsc_invariant;
+// nanoseconds per cycle as a 32.32 fixed point number, so conversions don't need a division
+static uint64_t ns_per_cycle;
+
+// counts TSC cycles while PIT channel 2 counts down from CALIBRATION_MS worth of ticks
+static uint64_t measure_pit_interval() {
+    uint16_t count = PIT_FREQUENCY * CALIBRATION_MS / 1000;
+
+    // gate off & speaker off while setting up
+    cpu_outb(PIT_GATE, cpu_inb(PIT_GATE) & ~0x03);
+    cpu_outb(PIT_COMMAND, 0xB0);    // channel 2, low byte then high byte, mode 0 (output goes high at 0), binary
+    cpu_outb(PIT_CHANNEL_2, count & 0xff);
+    cpu_outb(PIT_CHANNEL_2, count >> 8);
+
+    // raising the gate starts the count
+    uint64_t start = cycles_now();
+    cpu_outb(PIT_GATE, (cpu_inb(PIT_GATE) & ~0x02) | 0x01);
+    while(!(cpu_inb(PIT_GATE) & 0x20));
+    uint64_t end = cycles_now();
+
+    cpu_outb(PIT_GATE, cpu_inb(PIT_GATE) & ~0x01);
+    return end - start;
+}
+
+void clock_init() {
+    uint32_t max_extended = cpu_maxLeaf(0x80000000);
+    tsc_invariant = max_extended >= 0x80000007
+        && (cpu_cpuid(0x80000007, 0).edx & CPUID_80000007_EDX_INVARIANT_TSC) != 0;
+
+    // anything that delays us (like an SMI) only makes a run longer, so the shortest one is the most accurate
+    uint64_t best = -1;
+    for(int i = 0; i < CALIBRATION_RUNS; i++) {
+        uint64_t cycles = measure_pit_interval();
+        if(cycles < best) best = cycles;
+    }
+    uint16_t count = PIT_FREQUENCY * CALIBRATION_MS / 1000;
+    tsc_frequency = best * PIT_FREQUENCY / count;
+
+    ns_per_cycle = (1000000000ull << 32) / tsc_frequency;
+    tsc_start = cycles_now();
+}
+
+uint64_t clock_tscFrequency() {
+    return tsc_frequency;
+}
+
+int clock_tscInvariant() {
+    return tsc_invariant;
+}
+
+uint64_t time_cyclesToNs(uint64_t cycles) {
+    __extension__ unsigned __int128 product = (unsigned __int128) cycles * ns_per_cycle;
+    return product >> 32;
+}
+
+uint64_t time_now_ns() {
+    return time_cyclesToNs(cycles_now() - tsc_start);
+}
+
+// ns * tsc_frequency would overflow 64 bits after a couple of seconds, so whole seconds & the rest are done separately
+// (the rest is under 10^9, times a frequency under 2^34 still fits)
+uint64_t time_nsToCycles(uint64_t ns) {
+    return ns / 1000000000ull * tsc_frequency + ns % 1000000000ull * tsc_frequency / 1000000000ull;
+}
+
+void time_delay_ns(uint64_t ns) {
+    uint64_t end = cycles_now() + time_nsToCycles(ns);
+    while(cycles_now() < end) {
+        cpu_pause();
+    }
+}
@@ -0,0 +1,44 @@
+/* clock.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  timekeeping with the TSC, calibrated against the PIT at boot.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+// measures the TSC frequency, takes ~30 ms. nothing else in here works until it's done
+void clock_init();
+
+uint64_t clock_tscFrequency();
+// whether the TSC runs at a constant rate in every power state. if not, times are only roughly right
+int clock_tscInvariant();
+
+// raw TSC value, ~20 cycles to read
+static inline uint64_t cycles_now() {
+    return cpu_readTsc();
+}
+
+// nanoseconds since clock_init, monotonic
+uint64_t time_now_ns();
+uint64_t time_cyclesToNs(uint64_t cycles);
+uint64_t time_nsToCycles(uint64_t ns);
+
+// spins for at least this long
+void time_delay_ns(uint64_t ns);
+#define time_delay_us(us) time_delay_ns((uint64_t) (us) * 1000)
+#define time_delay_ms(ms) time_delay_ns((uint64_t) (ms) * 1000000)
+
+#endif
@@ -0,0 +1,160 @@
+/* cpu.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  small wrappers around instructions that C can't express
+ */
+
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t eax, ebx, ecx, edx;
+} cpuid_result;
+
+static inline cpuid_result cpu_cpuid(uint32_t leaf, uint32_t subleaf) {
+    cpuid_result result;
+    asm volatile("cpuid"
+        : "=a"(result.eax), "=b"(result.ebx), "=c"(result.ecx), "=d"(result.edx)
+        : "a"(leaf), "c"(subleaf));
+    return result;
+}
+
+static inline uint64_t cpu_readTsc() {
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t) high << 32) | low;
+}
+
+static inline void cpu_outb(uint16_t port, uint8_t value) {
+    asm volatile("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint8_t cpu_inb(uint16_t port) {
+    uint8_t value;
+    asm volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+// tells the cpu it's in a spin loop
+static inline void cpu_pause() {
+    asm volatile("pause");
+}
+
+#define RFLAGS_IF (1 << 9)
+
+// returns the old flags, to give to cpu_restoreInterrupts
+static inline uint64_t cpu_disableInterrupts() {
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void cpu_restoreInterrupts(uint64_t flags) {
+    if(flags & RFLAGS_IF) asm volatile("sti" : : : "memory");
+}
+
+// highest supported leaf, for either the basic (0) or extended (0x80000000) range
+static inline uint32_t cpu_maxLeaf(uint32_t base) {
+    return cpu_cpuid(base, 0).eax;
+}
+
+static inline uint64_t cpu_readMsr(uint32_t msr) {
+    uint32_t low, high;
+    asm volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t) high << 32) | low;
+}
+
+static inline void cpu_writeMsr(uint32_t msr, uint64_t value) {
+    asm volatile("wrmsr" : : "c"(msr), "a"((uint32_t) value), "d"((uint32_t) (value >> 32)) : "memory");
+}
+
+#define MSR_IA32_PAT 0x277
+#define MSR_IA32_EFER 0xC0000080
+#define EFER_NXE (1 << 11)
+
+static inline uint64_t cpu_readXcr(uint32_t xcr) {
+    uint32_t low, high;
+    asm volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(xcr));
+    return ((uint64_t) high << 32) | low;
+}
+
+static inline void cpu_writeXcr(uint32_t xcr, uint64_t value) {
+    asm volatile("xsetbv" : : "c"(xcr), "a"((uint32_t) value), "d"((uint32_t) (value >> 32)));
+}
+
+#define CR4_PCIDE   (1 << 17)
+#define CR4_OSXSAVE (1 << 18)
+
+static inline uint64_t cpu_readCr3() {
+    uint64_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    return cr3;
+}
+
+static inline void cpu_writeCr3(uint64_t cr3) {
+    asm volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+}
+
+static inline void cpu_invlpg(uint64_t address) {
+    asm volatile("invlpg (%0)" : : "r"(address) : "memory");
+}
+
+#define INVPCID_ADDRESS         0   // one address in one PCID
+#define INVPCID_SINGLE_CONTEXT  1   // everything in one PCID (except global pages)
+
+static inline void cpu_invpcid(uint64_t type, uint64_t pcid, uint64_t address) {
+    struct { uint64_t pcid, address; } descriptor = { pcid, address };
+    asm volatile("invpcid %0, %1" : : "m"(descriptor), "r"(type) : "memory");
+}
+
+#define XCR0_X87 (1 << 0)
+#define XCR0_SSE (1 << 1)
+#define XCR0_AVX (1 << 2)
+
+// leaf 0x00000001
+#define CPUID_1_EDX_PSE         (1 << 3)
+#define CPUID_1_EDX_PAT         (1 << 16)
+#define CPUID_1_ECX_PCID        (1 << 17)
+#define CPUID_1_ECX_XSAVE       (1 << 26)
+#define CPUID_1_ECX_OSXSAVE     (1 << 27)
+#define CPUID_1_ECX_AVX         (1 << 28)
+// leaf 0x00000007, subleaf 0
+#define CPUID_7_EBX_AVX2        (1 << 5)
+#define CPUID_7_EBX_ERMS        (1 << 9)
+#define CPUID_7_EBX_INVPCID     (1 << 10)
+// leaf 0x80000001
+#define CPUID_80000001_EDX_NX      (1 << 20)
+#define CPUID_80000001_EDX_PDPE1GB (1 << 26)
+// leaf 0x80000007
+#define CPUID_80000007_EDX_INVARIANT_TSC (1 << 8)
+
+// turns on the AVX register state (the firmware usually leaves it off). returns whether AVX can be used
+static inline int cpu_enableAvx() {
+    cpuid_result leaf1 = cpu_cpuid(1, 0);
+    if(!(leaf1.ecx & CPUID_1_ECX_XSAVE) || !(leaf1.ecx & CPUID_1_ECX_AVX)) return 0;
+
+    uint64_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    asm volatile("mov %0, %%cr4" : : "r"(cr4 | CR4_OSXSAVE));
+    cpu_writeXcr(0, cpu_readXcr(0) | XCR0_X87 | XCR0_SSE | XCR0_AVX);
+    return 1;
+}
+
+// whether AVX2 instructions can be used, which also needs the OS (cpu_enableAvx) to have turned on the AVX state
+static inline int cpu_hasAvx2() {
+    if(cpu_maxLeaf(0) < 7 || !(cpu_cpuid(7, 0).ebx & CPUID_7_EBX_AVX2)) return 0;
+    if(!(cpu_cpuid(1, 0).ecx & CPUID_1_ECX_OSXSAVE)) return 0;
+    return (cpu_readXcr(0) & (XCR0_SSE | XCR0_AVX)) == (XCR0_SSE | XCR0_AVX);
+}
+
+#endif
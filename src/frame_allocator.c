@@ -0,0 +1,194 @@
+/* frame_allocator.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "phys.h"
+#include "frame_allocator.h"
+
+// one metadata byte per frame. only the first frame of a block has a non-zero byte
+#define FRAME_STATE_FREE  0x80  // first frame of a free block, low bits are the order
+#define FRAME_STATE_USED  0x40  // first frame of an allocated block, low bits are the order
+#define FRAME_STATE_CACHED 0x20 // an allocated single frame that was freed into a per-cpu cache
+#define FRAME_STATE_ORDER 0x1f
+
+// free blocks are linked through their own first frame
+struct free_block {
+    struct free_block* next;
+    struct free_block* prev;
+};
+
+static uint8_t* frame_state;
+static uint64_t frame_base;
+static uint64_t frame_count;
+static struct free_block* free_lists[FRAME_MAX_ORDER + 1];
+
+static uint64_t free_frames;
+static uint64_t total_frames;
+
+#define BLOCK_ALIGN (FRAME_SIZE << FRAME_MAX_ORDER)
+
+static inline uint64_t frame_address(uint64_t frame) {
+    return frame_base + frame * FRAME_SIZE;
+}
+static inline uint64_t frame_number(uint64_t address) {
+    return (address - frame_base) / FRAME_SIZE;
+}
+
+static void list_push(uint32_t order, uint64_t frame) {
+    struct free_block* block = phys_to_virt(frame_address(frame));
+    block->prev = 0;
+    block->next = free_lists[order];
+    if(block->next) block->next->prev = block;
+    free_lists[order] = block;
+    frame_state[frame] = FRAME_STATE_FREE | order;
+}
+
+static void list_remove(uint32_t order, uint64_t frame) {
+    struct free_block* block = phys_to_virt(frame_address(frame));
+    if(block->prev) {
+        block->prev->next = block->next;
+    } else {
+        free_lists[order] = block->next;
+    }
+    if(block->next) block->next->prev = block->prev;
+    frame_state[frame] = 0;
+}
+
+// put a block on the free lists, merging it with its buddy as many times as possible
+static void free_block(uint64_t frame, uint32_t order) {
+    while(order < FRAME_MAX_ORDER) {
+        uint64_t buddy = frame ^ (1ull << order);
+        if(buddy >= frame_count || frame_state[buddy] != (FRAME_STATE_FREE | order)) break;
+        list_remove(order, buddy);
+        if(buddy < frame) frame = buddy;
+        order++;
+    }
+    list_push(order, frame);
+}
+
+uint64_t frame_metadataSize(uint64_t base_address, uint64_t end_address) {
+    base_address &= ~(uint64_t)(BLOCK_ALIGN - 1);
+    return (end_address - base_address + FRAME_SIZE - 1) / FRAME_SIZE;
+}
+
+void frame_init(uint8_t* metadata, uint64_t base_address, uint64_t end_address) {
+    // align the base so block alignment relative to the base is also physical alignment
+    frame_base = base_address & ~(uint64_t)(BLOCK_ALIGN - 1);
+    frame_count = frame_metadataSize(base_address, end_address);
+    frame_state = metadata;
+    for(uint64_t i = 0; i < frame_count; i++) {
+        frame_state[i] = 0;
+    }
+    for(uint32_t order = 0; order <= FRAME_MAX_ORDER; order++) {
+        free_lists[order] = 0;
+    }
+    free_frames = 0;
+    total_frames = 0;
+}
+
+void frame_addRegion(uint64_t address, uint64_t page_count) {
+    uint64_t end = address + page_count * FRAME_SIZE;
+    uint64_t limit = frame_address(frame_count);
+    if(address < frame_base) address = frame_base;
+    if(end > limit) end = limit;
+    // never hand out the null page, a free list link stored there would look like the end of the list
+    if(address == 0) address = FRAME_SIZE;
+    if(address >= end) return;
+
+    uint64_t frame = frame_number(address);
+    uint64_t last = frame_number(end);
+    while(frame < last) {
+        // the biggest block that is aligned here and still fits in the region
+        uint32_t order = 0;
+        while(order < FRAME_MAX_ORDER
+          && (frame & (1ull << order)) == 0
+          && frame + (2ull << order) <= last) {
+            order++;
+        }
+        free_block(frame, order);
+        free_frames += 1ull << order;
+        total_frames += 1ull << order;
+        frame += 1ull << order;
+    }
+}
+
+uint32_t frame_orderFor(uint64_t page_count) {
+    uint32_t order = 0;
+    while((1ull << order) < page_count) {
+        order++;
+    }
+    return order;
+}
+
+uint64_t frame_allocate(uint32_t order) {
+    if(order > FRAME_MAX_ORDER) return 0;
+
+    // find the smallest free block that is big enough, there are at most FRAME_MAX_ORDER lists to check
+    uint32_t found = order;
+    while(found <= FRAME_MAX_ORDER && !free_lists[found]) {
+        found++;
+    }
+    if(found > FRAME_MAX_ORDER) return 0;
+
+    uint64_t frame = frame_number(virt_to_phys(free_lists[found]));
+    list_remove(found, frame);
+    // split it, giving the upper halves back until it's the requested size
+    while(found > order) {
+        found--;
+        list_push(found, frame + (1ull << found));
+    }
+
+    frame_state[frame] = FRAME_STATE_USED | order;
+    free_frames -= 1ull << order;
+    return frame_address(frame);
+}
+
+uint64_t frame_free(uint64_t address) {
+    uint64_t frame = frame_number(address);
+    if(address < frame_base || frame >= frame_count || !(frame_state[frame] & FRAME_STATE_USED)) {
+        return 0; // not a block we handed out (or a double free)
+    }
+    uint32_t order = frame_state[frame] & FRAME_STATE_ORDER;
+    frame_state[frame] = 0;
+    free_frames += 1ull << order;
+    free_block(frame, order);
+    return 1ull << order;
+}
+
+int frame_orderOf(uint64_t address) {
+    uint64_t frame = frame_number(address);
+    if(address < frame_base || frame >= frame_count) return -1;
+    uint8_t state = frame_state[frame];
+    if(!(state & FRAME_STATE_USED)) return -1;
+    return state & FRAME_STATE_ORDER;
+}
+
+// the caches don't hold the allocator's lock, so these change only the cached bit, atomically
+int frame_markCached(uint64_t address) {
+    uint64_t frame = frame_number(address);
+    if(address < frame_base || frame >= frame_count) return 0;
+    uint8_t state = __atomic_load_n(&frame_state[frame], __ATOMIC_RELAXED);
+    if(state != FRAME_STATE_USED) return 0; // allocated, order 0, not cached yet
+    return __atomic_compare_exchange_n(&frame_state[frame], &state, state | FRAME_STATE_CACHED, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+void frame_unmarkCached(uint64_t address) {
+    __atomic_and_fetch(&frame_state[frame_number(address)], ~FRAME_STATE_CACHED, __ATOMIC_RELAXED);
+}
+
+uint64_t frame_freeCount() {
+    return free_frames;
+}
+uint64_t frame_totalCount() {
+    return total_frames;
+}
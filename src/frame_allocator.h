@@ -0,0 +1,54 @@
+/* frame_allocator.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  buddy allocator for physical page frames.
+  blocks are 2^order frames and are always aligned to their own size (relative to the base address).
+ */
+
+#ifndef FRAME_ALLOCATOR_H
+#define FRAME_ALLOCATOR_H
+
+#include <stdint.h>
+
+#define FRAME_SIZE 4096
+// largest block is 2^FRAME_MAX_ORDER frames (16 MiB)
+#define FRAME_MAX_ORDER 12
+
+// bytes of metadata needed to track every frame in [base_address, end_address)
+uint64_t frame_metadataSize(uint64_t base_address, uint64_t end_address);
+// metadata must be frame_metadataSize() bytes, it does not need to be zeroed
+void frame_init(uint8_t* metadata, uint64_t base_address, uint64_t end_address);
+
+// hand a range of frames to the allocator, parts outside of [base_address, end_address) are ignored
+void frame_addRegion(uint64_t address, uint64_t page_count);
+
+// smallest order whose block holds page_count frames
+uint32_t frame_orderFor(uint64_t page_count);
+// returns the physical address of a block of 2^order frames, or 0 if there is no block that large
+uint64_t frame_allocate(uint32_t order);
+// frees a block previously returned by frame_allocate (the order is remembered by the allocator).
+// returns how many frames were freed, 0 if address isn't the start of an allocated block
+uint64_t frame_free(uint64_t address);
+// order of the allocated block starting at address, or -1 if there isn't one.
+// only the owner of a block frees it, so this is safe to call without the allocator's lock for blocks you own
+int frame_orderOf(uint64_t address);
+
+// frames freed into a per-cpu cache still look allocated here, so marking them is what catches a second free of one
+// (memory_manager.c only does this in debug builds).
+// returns 0 (and marks nothing) if address isn't an allocated single frame, or is one that's already marked
+int frame_markCached(uint64_t address);
+// when a cached frame is handed out again
+void frame_unmarkCached(uint64_t address);
+
+uint64_t frame_freeCount();
+uint64_t frame_totalCount();
+
+#endif
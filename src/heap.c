@@ -0,0 +1,227 @@
+/* heap.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "term.h"
+#include "kprintf.h"
+#include "spinlock.h"
+#include "frame_allocator.h"
+#include "memory_manager.h"
+#include "heap.h"
+
+#define PAGE_SIZE 4096
+#define CACHE_LINE 64
+
+// slabs are naturally aligned (the frame allocator only gives out blocks aligned to their size),
+// so the header of the slab an object belongs to is found by rounding its address down
+#define SLAB_PAGES 4
+#define SLAB_SIZE (SLAB_PAGES * PAGE_SIZE)
+#define SLAB_MAGIC 0x51AB51AB
+
+typedef struct slab {
+    uint32_t magic;
+    uint16_t size_class;
+    uint16_t free_count;
+    void* free_list;            // objects link through their first 8 bytes
+    struct slab* next;          // in the class's list of slabs with free objects
+    struct slab* prev;
+    uint8_t padding[CACHE_LINE - 32];
+} slab;
+
+typedef struct {
+    slab* partial;              // slabs with at least one free object
+    uint64_t empty_slabs;       // how many of those are completely free
+    uint16_t capacity;          // objects per slab
+} size_class;
+
+static size_class classes[HEAP_CLASS_COUNT];
+static heap_stats stats;
+// guards the classes & stats, any cpu can kmalloc/kfree
+static spinlock heap_lock;
+
+static inline uint32_t class_for(size_t size) {
+    if(size <= HEAP_MIN_SMALL) return 0;
+    return 64 - __builtin_clzll(size - 1) - 4; // log2 of size rounded up, minus log2(HEAP_MIN_SMALL)
+}
+static inline uint64_t class_size(uint32_t size_class) {
+    return HEAP_MIN_SMALL << size_class;
+}
+
+static void list_remove(size_class* class, slab* s) {
+    if(s->prev) {
+        s->prev->next = s->next;
+    } else {
+        class->partial = s->next;
+    }
+    if(s->next) s->next->prev = s->prev;
+    s->next = 0;
+    s->prev = 0;
+}
+
+static void list_push(size_class* class, slab* s) {
+    s->prev = 0;
+    s->next = class->partial;
+    if(s->next) s->next->prev = s;
+    class->partial = s;
+}
+
+static slab* new_slab(uint32_t size_class) {
+    slab* s = memory_allocatePages(SLAB_PAGES);
+    if(!s) return 0;
+
+    uint64_t object_size = class_size(size_class);
+    s->magic = SLAB_MAGIC;
+    s->size_class = size_class;
+    s->free_count = 0;
+    s->free_list = 0;
+    s->next = 0;
+    s->prev = 0;
+
+    // build the free list back to front so objects are handed out in address order.
+    // page aligned slots are skipped: a page aligned pointer passed to kfree means a large object
+    uint8_t* base = (uint8_t*) s;
+    uint64_t count = (SLAB_SIZE - sizeof(slab)) / object_size;
+    for(uint64_t i = count; i > 0; i--) {
+        uint8_t* object = base + sizeof(slab) + (i - 1) * object_size;
+        if(((uint64_t) object & (PAGE_SIZE - 1)) == 0) continue;
+        *(void**) object = s->free_list;
+        s->free_list = object;
+        s->free_count++;
+    }
+
+    classes[size_class].capacity = s->free_count;
+    stats.classes[size_class].slabs++;
+    stats.classes[size_class].objects_total += s->free_count;
+    stats.slab_bytes += SLAB_SIZE;
+    return s;
+}
+
+static void* allocate(size_t size) {
+    if(size > HEAP_MAX_SMALL) { // large object, pages straight from the memory manager
+        uint64_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+        void* object = memory_allocatePages(pages);
+        if(!object) return 0;
+        // the buddy allocator hands out a power of two pages, which is also what memory_freePages gives back
+        pages = 1ull << frame_orderFor(pages);
+        stats.large_objects++;
+        stats.large_pages += pages;
+        stats.requested_bytes += size;
+        stats.rounded_bytes += pages * PAGE_SIZE;
+        return object;
+    }
+
+    uint32_t index = class_for(size);
+    size_class* class = &classes[index];
+    slab* s = class->partial;
+    if(!s) {
+        s = new_slab(index);
+        if(!s) return 0;
+        list_push(class, s);
+    } else if(s->free_count == class->capacity) {
+        class->empty_slabs--;
+    }
+
+    void* object = s->free_list;
+    s->free_list = *(void**) object;
+    s->free_count--;
+    if(s->free_count == 0) {
+        list_remove(class, s);
+    }
+
+    uint64_t object_size = class_size(index);
+    stats.classes[index].objects_used++;
+    stats.classes[index].allocations++;
+    stats.used_bytes += object_size;
+    stats.requested_bytes += size;
+    stats.rounded_bytes += object_size;
+    return object;
+}
+
+static void release(void* object) {
+    if(((uint64_t) object & (PAGE_SIZE - 1)) == 0) { // large object
+        uint64_t pages = memory_freePages(object);
+        if(pages) {
+            stats.large_objects--;
+            stats.large_pages -= pages;
+        }
+        return;
+    }
+
+    slab* s = (slab*) ((uint64_t) object & ~(uint64_t) (SLAB_SIZE - 1));
+    if(s->magic != SLAB_MAGIC) return; // not something kmalloc handed out
+    uint32_t index = s->size_class;
+    size_class* class = &classes[index];
+
+    if(s->free_count == 0) { // it was full, so it's not on the list
+        list_push(class, s);
+    }
+    *(void**) object = s->free_list;
+    s->free_list = object;
+    s->free_count++;
+
+    stats.classes[index].objects_used--;
+    stats.classes[index].frees++;
+    stats.used_bytes -= class_size(index);
+
+    if(s->free_count == class->capacity) {
+        // keep one empty slab around so an alloc/free pair at the edge doesn't go to the memory manager every time
+        if(class->empty_slabs > 0) {
+            list_remove(class, s);
+            s->magic = 0;
+            memory_freePages(s);
+            stats.classes[index].slabs--;
+            stats.classes[index].objects_total -= class->capacity;
+            stats.slab_bytes -= SLAB_SIZE;
+        } else {
+            class->empty_slabs++;
+        }
+    }
+}
+
+void* kmalloc(size_t size) {
+    spinlock_acquire(&heap_lock);
+    void* object = allocate(size);
+    spinlock_release(&heap_lock);
+    return object;
+}
+
+void kfree(void* object) {
+    if(!object) return;
+    spinlock_acquire(&heap_lock);
+    release(object);
+    spinlock_release(&heap_lock);
+}
+
+void heap_getStats(heap_stats* out) {
+    spinlock_acquire(&heap_lock);
+    *out = stats;
+    spinlock_release(&heap_lock);
+    for(uint32_t i = 0; i < HEAP_CLASS_COUNT; i++) {
+        out->classes[i].object_size = class_size(i);
+    }
+}
+
+void heap_printStats() {
+    heap_stats snapshot;
+    heap_getStats(&snapshot);
+    kprintf("heap: %lu KiB in slabs, %lu%% used, %lu%% of handed out bytes requested\n", snapshot.slab_bytes / 1024,
+        snapshot.slab_bytes ? snapshot.used_bytes * 100 / snapshot.slab_bytes : 0,
+        snapshot.rounded_bytes ? snapshot.requested_bytes * 100 / snapshot.rounded_bytes : 100);
+    for(uint32_t i = 0; i < HEAP_CLASS_COUNT; i++) {
+        heap_class_stats* class = &snapshot.classes[i];
+        if(class->slabs == 0) continue;
+        kprintf("  %lu B: %lu/%lu objects in %lu slabs\n", class_size(i), class->objects_used, class->objects_total, class->slabs);
+    }
+    kprintf("  large: %lu objects, %lu pages\n", snapshot.large_objects, snapshot.large_pages);
+}
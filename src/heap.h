@@ -0,0 +1,54 @@
+/* heap.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  kernel heap. objects up to HEAP_MAX_SMALL bytes come from slabs of one size class,
+  anything bigger gets its own pages straight from the memory manager.
+ */
+
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// size classes are powers of two from 16 to 2048 bytes
+#define HEAP_MIN_SMALL 16
+#define HEAP_MAX_SMALL 2048
+#define HEAP_CLASS_COUNT 8
+
+typedef struct {
+    uint64_t object_size;
+    uint64_t slabs;
+    uint64_t objects_used;
+    uint64_t objects_total;     // how many objects all of this class's slabs can hold
+    uint64_t allocations;       // lifetime counts
+    uint64_t frees;
+} heap_class_stats;
+
+typedef struct {
+    heap_class_stats classes[HEAP_CLASS_COUNT];
+    uint64_t large_objects;
+    uint64_t large_pages;
+    uint64_t slab_bytes;        // memory held by slabs (including their headers)
+    uint64_t used_bytes;        // how much of that is handed out as objects
+    uint64_t requested_bytes;   // lifetime total of sizes asked for, compared to
+    uint64_t rounded_bytes;     // the lifetime total of the class sizes that were handed out
+} heap_stats;
+
+// objects of 64 bytes or more are cache line aligned, smaller ones are aligned to their class size.
+// O(1) unless a new slab is needed. returns 0 if out of memory
+void* kmalloc(size_t size);
+void kfree(void* object);
+
+void heap_getStats(heap_stats* stats);
+void heap_printStats();
+
+#endif
@@ -0,0 +1,171 @@
+/* initrd.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "mem.h"
+#include "heap.h"
+#include "initrd.h"
+
+#define BLOCK_SIZE 512
+
+// ustar header, every field is text (numbers are octal)
+typedef struct {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char type;
+    char link_name[100];
+    char magic[6];          // "ustar"
+    char version[2];
+    char user_name[32];
+    char group_name[32];
+    char device_major[8];
+    char device_minor[8];
+    char prefix[155];       // ustar splits long paths into prefix & name
+    char padding[12];
+} tar_header;
+
+// open addressing with linear probing, kept at most half full
+static initrd_file* table;
+static uint64_t table_mask;
+static uint64_t file_count;
+
+static uint64_t parse_octal(const char* field, int length) {
+    int i = 0;
+    while(i < length && field[i] == ' ') i++;
+    uint64_t value = 0;
+    for(; i < length && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = value * 8 + field[i] - '0';
+    }
+    return value;
+}
+
+static uint64_t field_length(const char* field, uint64_t size) {
+    uint64_t length = 0;
+    while(length < size && field[length]) length++;
+    return length;
+}
+
+// the checksum is the sum of the header's bytes, counting the checksum field itself as spaces
+static int valid_header(const tar_header* header) {
+    const uint8_t* bytes = (const uint8_t*) header;
+    uint64_t sum = 0;
+    for(int i = 0; i < BLOCK_SIZE; i++) sum += bytes[i];
+    for(int i = 0; i < 8; i++) sum += ' ' - (uint8_t) header->checksum[i];
+    return sum == parse_octal(header->checksum, sizeof(header->checksum));
+}
+
+// FNV-1a, never 0 since that marks an empty slot
+static uint64_t hash_name(const char* name, uint64_t length) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for(uint64_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t) name[i]) * 0x100000001b3;
+    }
+    return hash ? hash : 1;
+}
+
+static const char* skip_root(const char* name, uint64_t* length) {
+    while(*length && name[0] == '/') {
+        name++;
+        (*length)--;
+    }
+    while(*length >= 2 && name[0] == '.' && name[1] == '/') {
+        name += 2;
+        *length -= 2;
+    }
+    return name;
+}
+
+static void insert(initrd_file file) {
+    file.hash = hash_name(file.name, file.name_length);
+    uint64_t slot = file.hash & table_mask;
+    while(table[slot].hash) {
+        initrd_file* other = &table[slot];
+        if(other->hash == file.hash && other->name_length == file.name_length && !memcmp(other->name, file.name, file.name_length)) {
+            *other = file; // in a tar the later copy of a file wins
+            return;
+        }
+        slot = (slot + 1) & table_mask;
+    }
+    table[slot] = file;
+    file_count++;
+}
+
+// goes through the headers, only counting the regular files unless insert is set
+static uint64_t walk(const uint8_t* archive, uint64_t size, int insert_files) {
+    uint64_t count = 0;
+    uint64_t offset = 0;
+    while(offset + BLOCK_SIZE <= size) {
+        const tar_header* header = (const tar_header*) (archive + offset);
+        if(!header->name[0] || !valid_header(header)) break; // the end marker is a zeroed block
+        uint64_t file_size = parse_octal(header->size, sizeof(header->size));
+        if(file_size > size) break;
+        uint64_t data_offset = offset + BLOCK_SIZE;
+        offset = data_offset + (file_size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+        if(header->type != '0' && header->type != '\0' && header->type != '7') continue;
+        if(data_offset + file_size > size) break;
+
+        uint64_t length = field_length(header->name, sizeof(header->name));
+        const char* name = header->name;
+        uint64_t prefix_length = memcmp(header->magic, "ustar", 5) ? 0 : field_length(header->prefix, sizeof(header->prefix));
+        if(prefix_length && insert_files) {
+            char* joined = kmalloc(prefix_length + 1 + length);
+            if(!joined) continue;
+            memcpy(joined, header->prefix, prefix_length);
+            joined[prefix_length] = '/';
+            memcpy(joined + prefix_length + 1, name, length);
+            name = joined;
+            length += prefix_length + 1;
+        }
+        name = skip_root(name, &length);
+        if(!length) continue;
+        count++;
+        if(insert_files) {
+            insert((initrd_file) { name, length, archive + data_offset, file_size, 0 });
+        }
+    }
+    return count;
+}
+
+uint64_t initrd_init(const void* archive, uint64_t size) {
+    if(!archive) return 0;
+    uint64_t count = walk(archive, size, 0);
+    uint64_t capacity = 16;
+    while(capacity < count * 2) capacity *= 2;
+    table = kmalloc(capacity * sizeof(initrd_file));
+    if(!table) return 0;
+    memzero(table, capacity * sizeof(initrd_file));
+    table_mask = capacity - 1;
+    walk(archive, size, 1);
+    return file_count;
+}
+
+const initrd_file* initrd_find(const char* path) {
+    if(!table) return 0;
+    uint64_t length = field_length(path, -1);
+    path = skip_root(path, &length);
+    uint64_t hash = hash_name(path, length);
+    for(uint64_t slot = hash & table_mask; table[slot].hash; slot = (slot + 1) & table_mask) {
+        initrd_file* file = &table[slot];
+        if(file->hash == hash && file->name_length == length && !memcmp(file->name, path, length)) return file;
+    }
+    return 0;
+}
+
+uint64_t initrd_fileCount() {
+    return file_count;
+}
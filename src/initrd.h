@@ -0,0 +1,37 @@
+/* initrd.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  the initial ramdisk: a tar archive the loader read into memory next to the kernel (see initrd/ & the makefile).
+  it's indexed once into a hash table, after that finding a file is one hash & usually one compare,
+  and a file's contents are just a pointer into the archive, nothing is copied
+ */
+
+#ifndef INITRD_H
+#define INITRD_H
+
+#include <stdint.h>
+
+typedef struct {
+    const char* name;       // not terminated, it's a slice of the archive too (unless it had a ustar prefix)
+    uint64_t name_length;
+    const uint8_t* data;
+    uint64_t size;
+    uint64_t hash;          // 0 for an empty slot
+} initrd_file;
+
+// indexes the regular files of the archive, stopping at the end marker or the first corrupt header.
+// needs the heap. returns how many files there are
+uint64_t initrd_init(const void* archive, uint64_t size);
+// paths are relative to the archive's root, a leading "./" or "/" is ignored. returns 0 if there's no such file
+const initrd_file* initrd_find(const char* path);
+uint64_t initrd_fileCount();
+
+#endif
@@ -0,0 +1,124 @@
+/* interrupts.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "term.h"
+#include "kprintf.h"
+#include "klog.h"
+#include "apic.h"
+#include "interrupts.h"
+
+#pragma pack (1)
+struct idt_entry {
+    uint16_t offset15_0;
+    uint16_t selector;
+    uint8_t  ist;
+    uint8_t  type;
+    uint16_t offset31_16;
+    uint32_t offset63_32;
+    uint32_t reserved;
+};
+
+struct table_ptr {
+    uint16_t limit;
+    uint64_t base;
+};
+#pragma pack ()
+
+// type 0x8E = 1000_1110 = present, privilege level 0, system ; 64-bit interrupt gate (clears IF)
+#define IDT_INTERRUPT_GATE 0x8E
+#define KERNEL_CODE_SELECTOR 0x08
+#define STUB_SIZE 16
+
+__attribute__((aligned(16)))
+static struct idt_entry idt[256];
+static interrupt_handler handlers[256];
+
+extern uint8_t interrupt_stubs[];
+// xsave component mask used by interrupt_common, 0 until AVX is on (then the stubs fall back to fxsave)
+uint32_t interrupt_xsaveMask;
+
+static const char exception_names[32][24] = {
+    "divide error", "debug", "NMI", "breakpoint", "overflow", "bound range", "invalid opcode", "device not available",
+    "double fault", "coprocessor overrun", "invalid TSS", "segment not present", "stack fault", "general protection", "page fault", "reserved",
+    "x87 floating point", "alignment check", "machine check", "SIMD floating point", "virtualization", "control protection", "reserved", "reserved",
+    "reserved", "reserved", "reserved", "reserved", "hypervisor injection", "VMM communication", "security", "reserved"
+};
+
+// legacy 8259 PIC ports
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+
+// the PIC can still raise spurious irq 7/15 while masked, so move it off the exception vectors first
+static void disable_pic() {
+    cpu_outb(PIC1_COMMAND, 0x11);   // ICW1: initialize, ICW4 follows
+    cpu_outb(PIC2_COMMAND, 0x11);
+    cpu_outb(PIC1_DATA, 0x20);      // ICW2: vector base
+    cpu_outb(PIC2_DATA, 0x28);
+    cpu_outb(PIC1_DATA, 0x04);      // ICW3: slave on irq 2
+    cpu_outb(PIC2_DATA, 0x02);
+    cpu_outb(PIC1_DATA, 0x01);      // ICW4: 8086 mode
+    cpu_outb(PIC2_DATA, 0x01);
+    cpu_outb(PIC1_DATA, 0xFF);      // mask everything
+    cpu_outb(PIC2_DATA, 0xFF);
+}
+
+void interrupts_fatal(interrupt_frame* frame) {
+    uint64_t cr2;
+    asm volatile("mov %%cr2, %0" : "=r"(cr2));
+    kprintf("\nexception %lu (%s) at rip %p, error 0x%lx, cr2 %p, rsp %p\n", frame->vector, exception_names[frame->vector],
+        (void*) frame->rip, frame->error_code, (void*) cr2, (void*) frame->rsp);
+    klog_dump(); // flushes the terminal too
+    while(1) asm volatile("cli; hlt");
+}
+
+void interrupts_dispatch(interrupt_frame* frame) {
+    uint64_t vector = frame->vector;
+    if(vector == INTERRUPT_SPURIOUS) return;
+
+    interrupt_handler handler = handlers[vector];
+    if(handler) {
+        handler(frame);
+    } else if(vector < 32) {
+        interrupts_fatal(frame);
+    }
+    if(vector >= INTERRUPT_IRQ_BASE) apic_eoi();
+}
+
+void interrupts_init() {
+    // cpu_enableAvx has already run, so the ymm registers are live and fxsave alone would lose their upper halves
+    if(cpu_cpuid(1, 0).ecx & CPUID_1_ECX_OSXSAVE) {
+        interrupt_xsaveMask = cpu_readXcr(0) & (XCR0_X87 | XCR0_SSE | XCR0_AVX);
+    }
+    for(int vector = 0; vector < 256; vector++) {
+        uint64_t stub = (uint64_t) &interrupt_stubs[vector * STUB_SIZE];
+        idt[vector] = (struct idt_entry) {
+            stub & 0xffff, KERNEL_CODE_SELECTOR, 0, IDT_INTERRUPT_GATE,
+            (stub >> 16) & 0xffff, stub >> 32, 0
+        };
+    }
+    disable_pic();
+    interrupts_load();
+}
+
+void interrupts_load() {
+    struct table_ptr idt_ptr = { sizeof(idt)-1, (uint64_t)&idt };
+    asm volatile("lidt %0" : : "m"(idt_ptr));
+}
+
+void interrupts_setHandler(uint8_t vector, interrupt_handler handler) {
+    handlers[vector] = handler;
+}
@@ -0,0 +1,48 @@
+/* interrupts.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  the interrupt descriptor table, shared by every cpu. handlers run with interrupts off.
+  exceptions without a handler print what happened and halt
+ */
+
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include <stdint.h>
+
+#define INTERRUPT_PAGE_FAULT 14
+
+// ISA irq n is routed to vector INTERRUPT_IRQ_BASE + n
+#define INTERRUPT_IRQ_BASE 0x30
+// the local APIC's spurious vector, ignored (and never acknowledged)
+#define INTERRUPT_SPURIOUS 0xFF
+
+// the general purpose registers, in the order interrupt_common pushes them, then what the stub & cpu pushed
+typedef struct {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rbp, rdi, rsi, rdx, rcx, rbx, rax;
+    uint64_t vector;
+    uint64_t error_code;        // 0 for vectors that don't have one
+    uint64_t rip, cs, rflags, rsp, ss;
+} interrupt_frame;
+
+typedef void (*interrupt_handler)(interrupt_frame* frame);
+
+// builds the IDT and loads it on this cpu, and masks the legacy PIC so only the APICs deliver interrupts
+void interrupts_init();
+// loads the IDT on another cpu
+void interrupts_load();
+// vectors from INTERRUPT_IRQ_BASE up are acknowledged at the local APIC after the handler returns
+void interrupts_setHandler(uint8_t vector, interrupt_handler handler);
+// prints the frame and halts, for exception handlers that were given something they can't fix
+__attribute__((noreturn)) void interrupts_fatal(interrupt_frame* frame);
+
+#endif
@@ -0,0 +1,179 @@
+/* klog.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "cpu.h"
+#include "mem.h"
+#include "clock.h"
+#include "percpu.h"
+#include "term.h"
+#include "serial.h"
+#include "kprintf.h"
+#include "klog.h"
+
+#define RING_MASK (KLOG_RING_SIZE - 1)
+
+// record n lives in ring[n & RING_MASK]. writers claim positions by incrementing reserved and never wait for the
+// consumer, a writer that laps it just overwrites the old record. the consumer notices from the record's sequence
+// (two writers a whole lap apart filling in the same record at once would mix up its text, but that's 256 records
+// written while one is still being filled in)
+static __attribute__((aligned(64))) klog_record ring[KLOG_RING_SIZE];
+static volatile uint64_t reserved;  // position the next writer gets
+static uint64_t consumed;           // next position to drain, only touched while holding draining
+static volatile uint32_t draining;
+static volatile uint64_t lost;
+
+static uint64_t start_tsc;
+static int drain_level = KLOG_INFO;
+
+static const char level_names[4][6] = { "debug", "info", "warn", "error" };
+
+void klog_init(uint64_t tsc) {
+    start_tsc = tsc;
+}
+
+void klog_setLevel(int level) {
+    drain_level = level;
+}
+
+static klog_record* begin_record(int level, uint64_t* position) {
+    *position = __atomic_fetch_add(&reserved, 1, __ATOMIC_RELAXED);
+    klog_record* record = &ring[*position & RING_MASK];
+    // mark it unfinished before changing anything, so a consumer copying it out sees that it changed underneath it
+    __atomic_store_n(&record->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    record->tsc = cycles_now();
+    record->level = level;
+    record->cpu = cpu_current()->index;
+    return record;
+}
+
+static void finish_record(klog_record* record, uint64_t length, uint64_t position) {
+    if(length > KLOG_TEXT_SIZE) length = KLOG_TEXT_SIZE;
+    if(length && record->text[length - 1] == '\n') length--;
+    record->length = length;
+    __atomic_store_n(&record->sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+void klog(int level, const char* format, ...) {
+    uint64_t position;
+    klog_record* record = begin_record(level, &position);
+    va_list args;
+    va_start(args, format);
+    // formatted right into the record, so there's no second copy
+    int length = kvsnprintf(record->text, KLOG_TEXT_SIZE, format, args);
+    va_end(args);
+    if(length >= KLOG_TEXT_SIZE) length = KLOG_TEXT_SIZE - 1; // the last byte is kvsnprintf's terminator
+    finish_record(record, length, position);
+}
+
+void klog_write(int level, const char* text, uint64_t length) {
+    uint64_t position;
+    klog_record* record = begin_record(level, &position);
+    memcpy(record->text, text, length < KLOG_TEXT_SIZE ? length : KLOG_TEXT_SIZE);
+    finish_record(record, length, position);
+}
+
+// copies a finished record out. returns 0 if it isn't finished (or was overwritten while being copied)
+static int read_record(uint64_t position, klog_record* copy) {
+    klog_record* record = &ring[position & RING_MASK];
+    if(__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != position + 1) return 0;
+    copy->tsc = record->tsc;
+    copy->length = record->length < KLOG_TEXT_SIZE ? record->length : KLOG_TEXT_SIZE;
+    copy->level = record->level;
+    copy->cpu = record->cpu;
+    memcpy(copy->text, record->text, copy->length);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&record->sequence, __ATOMIC_RELAXED) == position + 1;
+}
+
+// "[    1.234567 cpu2] warn: text\n"
+static uint64_t format_record(const klog_record* record, char* line) {
+    uint64_t us = time_cyclesToNs(record->tsc - start_tsc) / 1000;
+    uint64_t length = ksnprintf(line, 32, "[%5lu.%06lu cpu%u] ", us / 1000000, us % 1000000, record->cpu);
+    uint64_t level = record->level < 4 ? record->level : 3;
+    length += ksnprintf(line + length, 8, "%s: ", level_names[level]);
+    memcpy(line + length, record->text, record->length);
+    length += record->length;
+    line[length++] = '\n';
+    return length;
+}
+
+#define LINE_SIZE (32 + 8 + KLOG_TEXT_SIZE + 1)
+
+static void terminal_sink(const klog_record* record) {
+    char line[LINE_SIZE];
+    term_writeBuffer(line, format_record(record, line));
+}
+
+int klog_drainTo(klog_sink sink) {
+    if(__atomic_exchange_n(&draining, 1, __ATOMIC_ACQUIRE)) return 0;
+    uint64_t end = __atomic_load_n(&reserved, __ATOMIC_ACQUIRE);
+    uint64_t position = consumed;
+    if(end - position > KLOG_RING_SIZE) { // lapped, those records are gone
+        __atomic_add_fetch(&lost, end - KLOG_RING_SIZE - position, __ATOMIC_RELAXED);
+        position = end - KLOG_RING_SIZE;
+    }
+    int drained = 0;
+    klog_record copy;
+    while(position < end) {
+        if(!read_record(position, &copy)) {
+            // either its writer is still filling it in (pick it up next time),
+            // or a writer a lap ahead has taken the record over
+            if(__atomic_load_n(&reserved, __ATOMIC_ACQUIRE) - position <= KLOG_RING_SIZE) break;
+            __atomic_add_fetch(&lost, 1, __ATOMIC_RELAXED);
+            position++;
+            continue;
+        }
+        position++;
+        if(copy.level < drain_level) continue;
+        sink(&copy);
+        drained++;
+    }
+    consumed = position;
+    __atomic_store_n(&draining, 0, __ATOMIC_RELEASE);
+    return drained;
+}
+
+int klog_drain() {
+    int drained = klog_drainTo(terminal_sink);
+    term_flush(); // everything printed since the last drain, not just the log
+    return drained;
+}
+
+uint64_t klog_lostCount() {
+    return lost;
+}
+
+void klog_dump() {
+    uint64_t end = __atomic_load_n(&reserved, __ATOMIC_ACQUIRE);
+    uint64_t position = end > KLOG_RING_SIZE ? end - KLOG_RING_SIZE : 0;
+    char line[LINE_SIZE];
+    klog_record copy;
+    uint64_t length = ksnprintf(line, LINE_SIZE, "klog: last %lu records\n", end - position);
+    for(;;) {
+        if(serial_present()) {
+            while(!serial_write(line, length)) serial_flush();
+        } else {
+            term_writeBuffer(line, length);
+        }
+        // unfinished records (like one a hung cpu was filling in) are skipped
+        while(position < end && !read_record(position, &copy)) position++;
+        if(position == end) break;
+        length = format_record(&copy, line);
+        position++;
+    }
+    serial_flush();
+    term_flush();
+}
@@ -0,0 +1,65 @@
+/* klog.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  kernel log. writers claim a record in a lock-free ring and fill it in, nothing gets rendered on their path.
+  klog_drain moves the records to the terminal later, from whichever cpu is idle.
+  when the ring wraps the oldest records are overwritten, so it always holds the latest KLOG_RING_SIZE of them.
+ */
+
+#ifndef KLOG_H
+#define KLOG_H
+
+#include <stdint.h>
+
+// must be a power of two
+#define KLOG_RING_SIZE 256
+// text longer than this is cut off
+#define KLOG_TEXT_SIZE 108
+
+#define KLOG_DEBUG 0
+#define KLOG_INFO  1
+#define KLOG_WARN  2
+#define KLOG_ERROR 3
+
+typedef struct {
+    volatile uint64_t sequence; // the record's position in the log + 1 once it's written, 0 while a writer is filling it in
+    uint64_t tsc;
+    uint16_t length;
+    uint8_t level;
+    uint8_t cpu;
+    char text[KLOG_TEXT_SIZE];  // one line, not terminated
+} klog_record;
+
+typedef void (*klog_sink)(const klog_record* record);
+
+// timestamps are printed relative to this tsc value
+void klog_init(uint64_t start_tsc);
+// records below this level stay in the ring (for klog_dump) but aren't drained. KLOG_INFO by default
+void klog_setLevel(int level);
+
+// safe from any cpu & from interrupt handlers, once percpu_initBsp has run. a trailing '\n' isn't needed
+__attribute__((format(printf, 2, 3)))
+void klog(int level, const char* format, ...);
+// the same without formatting, just a copy
+void klog_write(int level, const char* text, uint64_t length);
+
+// sends every finished record that hasn't been drained yet to the terminal. returns how many records it took.
+// only one cpu drains at a time, the others return 0 right away
+int klog_drain();
+int klog_drainTo(klog_sink sink);
+// records that were overwritten before they could be drained
+uint64_t klog_lostCount();
+
+// prints everything still in the ring, drained or not, by polling the serial port (or on the terminal without one).
+// with a serial port it doesn't take any locks, so it also works after a hang or from a debugger: `call klog_dump()`
+void klog_dump();
+
+#endif
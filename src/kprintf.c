@@ -0,0 +1,439 @@
+/* kprintf.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "term.h"
+#include "kprintf.h"
+
+// kprintf's buffer. longer output is written in more than one piece
+#define KPRINTF_BUFFER 512
+
+// where formatted characters go. a full buffer is either written to the terminal (kprintf) or the rest is dropped (ksnprintf)
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t position;
+    size_t total;
+    int to_terminal;
+} output;
+
+static void put(output* out, char c) {
+    if(out->position == out->size) {
+        if(!out->to_terminal) {
+            out->total++;
+            return;
+        }
+        term_writeBuffer(out->buffer, out->position);
+        out->position = 0;
+    }
+    out->buffer[out->position++] = c;
+    out->total++;
+}
+
+static void pad(output* out, char c, int count) {
+    while(count-- > 0) put(out, c);
+}
+
+// one conversion's flags, width & precision
+typedef struct {
+    int left;       // -
+    int plus;       // +
+    int space;      // ' '
+    int alternate;  // #
+    int zero;       // 0
+    int width;
+    int precision;  // -1 if there wasn't one
+} spec;
+
+// writes the left padding, the prefix (sign and/or 0x) and the zeros of a field whose body is `length` characters long.
+// the caller writes the body, format pads the right side for -
+static void pad_field(output* out, const spec* spec, const char* prefix, int zeros, int length, int zero_fill) {
+    int prefix_length = 0;
+    while(prefix[prefix_length]) prefix_length++;
+    int total = prefix_length + zeros + length;
+    if(zero_fill && spec->zero && !spec->left && total < spec->width) {
+        zeros += spec->width - total;
+        total = spec->width;
+    }
+    if(!spec->left) pad(out, ' ', spec->width - total);
+    while(*prefix) put(out, *prefix++);
+    pad(out, '0', zeros);
+}
+
+static void put_integer(output* out, const spec* spec, uint64_t value, int base, int uppercase, const char* prefix) {
+    // digits go into a small buffer backwards
+    char digits[22];
+    int length = 0;
+    const char* symbols = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+    while(value) {
+        digits[length++] = symbols[value % base];
+        value /= base;
+    }
+    if(length == 0 && spec->precision != 0) digits[length++] = '0';
+
+    int zeros = spec->precision > length ? spec->precision - length : 0;
+    if(base == 8 && spec->alternate && zeros == 0 && (length == 0 || digits[length - 1] != '0')) zeros = 1;
+    // the 0 flag is ignored when there's a precision
+    pad_field(out, spec, prefix, zeros, length, spec->precision < 0);
+    while(length) put(out, digits[--length]);
+}
+
+// --- floating point ---
+
+// 10^n for n >= 0. exact up to 10^27. long double (the x87's 64-bit mantissa) keeps the
+// rounding errors of the bigger powers well below the 17 digits float_digits makes
+static long double power_of_ten(int n) {
+    long double result = 1;
+    long double power = 10;
+    while(n) {
+        if(n & 1) result *= power;
+        power *= power;
+        n >>= 1;
+    }
+    return result;
+}
+
+// value * 10^n
+static long double scale(long double value, int n) {
+    return n >= 0 ? value * power_of_ten(n) : value / power_of_ten(-n);
+}
+
+// the first `count` (at most 17) significant decimal digits of a positive finite value, rounded (ties to even),
+// and the power of ten of the first one
+static void float_digits(double value, int count, char* digits, int* exponent) {
+    if(value == 0) {
+        for(int i = 0; i < count; i++) digits[i] = '0';
+        *exponent = 0;
+        return;
+    }
+    union { double d; uint64_t u; } bits = { value };
+    int binary_exponent = (int) ((bits.u >> 52) & 0x7ff) - 1023;
+    int decimal_exponent = (binary_exponent * 78913) >> 18; // floor(binary_exponent * log10(2))
+    long double mantissa = scale(value, -decimal_exponent);
+    while(mantissa >= 10) mantissa = scale(value, -(++decimal_exponent));
+    while(mantissa < 1) mantissa = scale(value, -(--decimal_exponent));
+
+    long double scaled = mantissa * power_of_ten(count - 1);
+    uint64_t rounded = (uint64_t) scaled;
+    long double fraction = scaled - rounded;
+    if(fraction > 0.5L || (fraction == 0.5L && (rounded & 1))) rounded++;
+    if(rounded >= (uint64_t) power_of_ten(count)) { // rounded up to the next power of ten
+        rounded /= 10;
+        decimal_exponent++;
+    }
+    for(int i = count - 1; i >= 0; i--) {
+        digits[i] = '0' + rounded % 10;
+        rounded /= 10;
+    }
+    *exponent = decimal_exponent;
+}
+
+#define MAX_DIGITS 17
+
+// the digits past the ones float_digits made are all 0
+static char digit_at(const char* digits, int count, int index) {
+    return index >= 0 && index < count ? digits[index] : '0';
+}
+
+// how many digits after the first are needed to show everything up to the last non-zero one
+static int significant_fraction(const char* digits, int count) {
+    int last = count - 1;
+    while(last > 0 && digits[last] == '0') last--;
+    return last;
+}
+
+static void put_exponent_float(output* out, const spec* spec, const char* prefix, double value, int precision, int strip, int uppercase) {
+    char digits[MAX_DIGITS];
+    int count = precision + 1 < MAX_DIGITS ? precision + 1 : MAX_DIGITS;
+    int exponent;
+    float_digits(value, count, digits, &exponent);
+    if(strip && precision > significant_fraction(digits, count)) precision = significant_fraction(digits, count);
+
+    char exponent_digits[4];
+    int exponent_length = 0;
+    int magnitude = exponent < 0 ? -exponent : exponent;
+    do {
+        exponent_digits[exponent_length++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while(magnitude || exponent_length < 2);
+
+    int point = precision > 0 || spec->alternate;
+    int length = 1 + point + precision + 2 + exponent_length;
+    pad_field(out, spec, prefix, 0, length, 1);
+    put(out, digits[0]);
+    if(point) put(out, '.');
+    for(int i = 1; i <= precision; i++) put(out, digit_at(digits, count, i));
+    put(out, uppercase ? 'E' : 'e');
+    put(out, exponent < 0 ? '-' : '+');
+    while(exponent_length) put(out, exponent_digits[--exponent_length]);
+}
+
+static void put_fixed_float(output* out, const spec* spec, const char* prefix, double value, int precision, int strip) {
+    char digits[MAX_DIGITS];
+    int exponent;
+    float_digits(value, MAX_DIGITS, digits, &exponent);
+    // rounding to `precision` places leaves this many significant digits
+    int count = exponent + 1 + precision;
+    if(count > MAX_DIGITS) {
+        count = MAX_DIGITS;
+    } else if(count <= 0) {
+        // smaller than the last place shown. it either rounds to 0 or up to a 1 in the last place
+        // (ties go to the even 0)
+        int round_up = count == 0 && (digits[0] > '5' || (digits[0] == '5' && significant_fraction(digits, MAX_DIGITS) > 0));
+        count = 1;
+        digits[0] = round_up ? '1' : '0';
+        exponent = -precision;
+    } else {
+        float_digits(value, count, digits, &exponent);
+    }
+    if(strip) {
+        int needed = significant_fraction(digits, count) - exponent;
+        if(needed < 0) needed = 0;
+        if(precision > needed) precision = needed;
+    }
+
+    int integer_length = exponent >= 0 ? exponent + 1 : 1;
+    int point = precision > 0 || spec->alternate;
+    int length = integer_length + point + precision;
+    pad_field(out, spec, prefix, 0, length, 1);
+    if(exponent >= 0) {
+        for(int i = 0; i <= exponent; i++) put(out, digit_at(digits, count, i));
+    } else {
+        put(out, '0');
+    }
+    if(point) put(out, '.');
+    for(int i = 1; i <= precision; i++) put(out, digit_at(digits, count, exponent + i));
+}
+
+// %a: 0x1.<13 hex digits>p<exponent>, exact unless a precision cuts it short
+static void put_hex_float(output* out, const spec* spec, const char* prefix_sign, double value, int uppercase) {
+    union { double d; uint64_t u; } bits = { value };
+    uint64_t mantissa = bits.u & 0xfffffffffffffull;
+    int biased = (bits.u >> 52) & 0x7ff;
+    int lead = biased != 0;
+    int exponent = biased ? biased - 1023 : (mantissa ? -1022 : 0);
+    int precision = spec->precision;
+    if(precision < 0) { // just enough digits to be exact
+        precision = 13;
+        while(precision > 0 && !((mantissa >> (4 * (13 - precision))) & 0xf)) precision--;
+    } else if(precision < 13) {
+        int shift = 4 * (13 - precision);
+        mantissa += 1ull << (shift - 1); // round half up, carrying into the leading digit
+        lead += mantissa >> 52;
+        mantissa &= 0xfffffffffffffull;
+        mantissa &= ~((1ull << shift) - 1);
+    }
+
+    char prefix[4] = { 0 };
+    int prefix_length = 0;
+    if(prefix_sign[0]) prefix[prefix_length++] = prefix_sign[0];
+    prefix[prefix_length++] = '0';
+    prefix[prefix_length++] = uppercase ? 'X' : 'x';
+
+    char exponent_digits[5];
+    int exponent_length = 0;
+    int magnitude = exponent < 0 ? -exponent : exponent;
+    do {
+        exponent_digits[exponent_length++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while(magnitude);
+
+    const char* symbols = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+    int point = precision > 0 || spec->alternate;
+    int length = 1 + point + precision + 2 + exponent_length;
+    pad_field(out, spec, prefix, 0, length, 1);
+    put(out, '0' + lead);
+    if(point) put(out, '.');
+    for(int i = 1; i <= precision; i++) put(out, i <= 13 ? symbols[(mantissa >> (4 * (13 - i))) & 0xf] : '0');
+    put(out, uppercase ? 'P' : 'p');
+    put(out, exponent < 0 ? '-' : '+');
+    while(exponent_length) put(out, exponent_digits[--exponent_length]);
+}
+
+static void put_float(output* out, const spec* spec, double value, char conversion) {
+    union { double d; uint64_t u; } bits = { value };
+    int negative = bits.u >> 63;
+    if(negative) value = -value;
+    char prefix[2] = { negative ? '-' : spec->plus ? '+' : spec->space ? ' ' : 0, 0 };
+    int uppercase = conversion >= 'A' && conversion <= 'Z';
+
+    if(value != value || value > 1.7976931348623157e308) { // nan or inf, never zero filled
+        const char* text = value != value ? (uppercase ? "NAN" : "nan") : (uppercase ? "INF" : "inf");
+        pad_field(out, spec, prefix, 0, 3, 0);
+        while(*text) put(out, *text++);
+        return;
+    }
+
+    int precision = spec->precision < 0 ? 6 : spec->precision;
+    switch(conversion | 0x20) {
+        case 'a':
+            put_hex_float(out, spec, prefix, value, uppercase);
+            break;
+        case 'e':
+            put_exponent_float(out, spec, prefix, value, precision, 0, uppercase);
+            break;
+        case 'f':
+            put_fixed_float(out, spec, prefix, value, precision, 0);
+            break;
+        case 'g': {
+            // %e or %f depending on the exponent, with `precision` significant digits & no trailing zeros
+            if(precision == 0) precision = 1;
+            char digits[MAX_DIGITS];
+            int exponent;
+            float_digits(value, precision < MAX_DIGITS ? precision : MAX_DIGITS, digits, &exponent);
+            if(exponent < precision && exponent >= -4) {
+                put_fixed_float(out, spec, prefix, value, precision - 1 - exponent, !spec->alternate);
+            } else {
+                put_exponent_float(out, spec, prefix, value, precision - 1, !spec->alternate, uppercase);
+            }
+            break;
+        }
+    }
+}
+
+static void format(output* out, const char* format, va_list args) {
+    for(; *format; format++) {
+        if(*format != '%') {
+            put(out, *format);
+            continue;
+        }
+        format++;
+
+        spec spec = { 0, 0, 0, 0, 0, 0, -1 };
+        for(;; format++) {
+            if(*format == '-') spec.left = 1;
+            else if(*format == '+') spec.plus = 1;
+            else if(*format == ' ') spec.space = 1;
+            else if(*format == '#') spec.alternate = 1;
+            else if(*format == '0') spec.zero = 1;
+            else break;
+        }
+        if(*format == '*') {
+            spec.width = va_arg(args, int);
+            if(spec.width < 0) {
+                spec.left = 1;
+                spec.width = -spec.width;
+            }
+            format++;
+        }
+        for(; *format >= '0' && *format <= '9'; format++) {
+            spec.width = spec.width * 10 + (*format - '0');
+        }
+        if(*format == '.') {
+            format++;
+            spec.precision = 0;
+            if(*format == '*') {
+                spec.precision = va_arg(args, int);
+                if(spec.precision < 0) spec.precision = -1;
+                format++;
+            }
+            for(; *format >= '0' && *format <= '9'; format++) {
+                spec.precision = spec.precision * 10 + (*format - '0');
+            }
+        }
+        int wide = 0;
+        for(;; format++) {
+            if(*format == 'l' || *format == 'z' || *format == 'j' || *format == 't') wide = 1;
+            else if(*format != 'h') break;
+        }
+
+        uint64_t start = out->total;
+        switch(*format) {
+            case 'd':
+            case 'i': {
+                int64_t value = wide ? va_arg(args, int64_t) : va_arg(args, int);
+                const char* sign = value < 0 ? "-" : spec.plus ? "+" : spec.space ? " " : "";
+                // negating in unsigned works for the most negative value too
+                put_integer(out, &spec, value < 0 ? -(uint64_t) value : (uint64_t) value, 10, 0, sign);
+                break;
+            }
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X': {
+                uint64_t value = wide ? va_arg(args, uint64_t) : va_arg(args, unsigned int);
+                int base = *format == 'u' ? 10 : *format == 'o' ? 8 : 16;
+                const char* prefix = base == 16 && spec.alternate && value ? (*format == 'X' ? "0X" : "0x") : "";
+                put_integer(out, &spec, value, base, *format == 'X', prefix);
+                break;
+            }
+            case 'p': {
+                spec.precision = 16;
+                put_integer(out, &spec, (uint64_t) va_arg(args, void*), 16, 0, "0x");
+                break;
+            }
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                put_float(out, &spec, va_arg(args, double), *format);
+                break;
+            case 'c':
+                if(!spec.left) pad(out, ' ', spec.width - 1);
+                put(out, (char) va_arg(args, int));
+                break;
+            case 's': {
+                const char* string = va_arg(args, const char*);
+                if(!string) string = "(null)";
+                int length = 0;
+                while(string[length] && (spec.precision < 0 || length < spec.precision)) length++;
+                if(!spec.left) pad(out, ' ', spec.width - length);
+                for(int i = 0; i < length; i++) put(out, string[i]);
+                break;
+            }
+            case '%':
+                put(out, '%');
+                break;
+            case 0: // a % at the very end
+                return;
+            default: // not a conversion we know, print it as it was
+                put(out, '%');
+                put(out, *format);
+                break;
+        }
+        if(spec.left) pad(out, ' ', spec.width - (int) (out->total - start));
+    }
+}
+
+int kvsnprintf(char* buffer, size_t size, const char* format_string, va_list args) {
+    // keep one character for the terminator
+    output out = { buffer, size ? size - 1 : 0, 0, 0, 0 };
+    format(&out, format_string, args);
+    if(size) buffer[out.position] = 0;
+    return out.total;
+}
+
+int ksnprintf(char* buffer, size_t size, const char* format_string, ...) {
+    va_list args;
+    va_start(args, format_string);
+    int length = kvsnprintf(buffer, size, format_string, args);
+    va_end(args);
+    return length;
+}
+
+int kprintf(const char* format_string, ...) {
+    char buffer[KPRINTF_BUFFER];
+    output out = { buffer, sizeof(buffer), 0, 0, 1 };
+    va_list args;
+    va_start(args, format_string);
+    format(&out, format_string, args);
+    va_end(args);
+    term_writeBuffer(buffer, out.position);
+    return out.total;
+}
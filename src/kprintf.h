@@ -0,0 +1,31 @@
+/* kprintf.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  printf for the kernel. supports %d %i %u %o %x %X %p %s %c %% and %e %f %g %a (and their uppercase forms),
+  with the - + space # 0 flags, a width & precision (or *), and the l/ll/z/j/t size prefixes for 64-bit values.
+  floating point is exact to 17 significant digits, anything past that is printed as 0
+ */
+
+#ifndef KPRINTF_H
+#define KPRINTF_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+// formats into a stack buffer and writes it to the terminal in one call. returns how many characters were written
+__attribute__((format(printf, 1, 2)))
+int kprintf(const char* format, ...);
+// like snprintf: always terminates the buffer (if size > 0) and returns the length the whole output would have had
+__attribute__((format(printf, 3, 4)))
+int ksnprintf(char* buffer, size_t size, const char* format, ...);
+int kvsnprintf(char* buffer, size_t size, const char* format, va_list args);
+
+#endif
@@ -0,0 +1,613 @@
+/* libc.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  the C library functions behind the headers in src/libc/, for Lua. built with -Isrc/libc
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <locale.h>
+#include <errno.h>
+#include <time.h>
+#include <ctype.h>
+
+#include "heap.h"
+#include "term.h"
+#include "clock.h"
+#include "kprintf.h"
+
+int errno;
+
+// --- string.h ---
+
+void* memchr(const void* memory, int value, size_t length) {
+    const uint8_t* bytes = memory;
+    for(size_t i = 0; i < length; i++) {
+        if(bytes[i] == (uint8_t) value) return (void*) (bytes + i);
+    }
+    return 0;
+}
+
+size_t strlen(const char* string) {
+    size_t length = 0;
+    while(string[length]) length++;
+    return length;
+}
+
+int strcmp(const char* a, const char* b) {
+    while(*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return (uint8_t) *a - (uint8_t) *b;
+}
+
+int strncmp(const char* a, const char* b, size_t length) {
+    for(; length; length--, a++, b++) {
+        if(*a != *b || !*a) return (uint8_t) *a - (uint8_t) *b;
+    }
+    return 0;
+}
+
+int strcoll(const char* a, const char* b) {
+    return strcmp(a, b);
+}
+
+char* strcpy(char* destination, const char* source) {
+    char* start = destination;
+    while((*destination++ = *source++));
+    return start;
+}
+
+char* strncpy(char* destination, const char* source, size_t length) {
+    size_t i = 0;
+    for(; i < length && source[i]; i++) destination[i] = source[i];
+    for(; i < length; i++) destination[i] = 0;
+    return destination;
+}
+
+char* strchr(const char* string, int c) {
+    for(;; string++) {
+        if(*string == (char) c) return (char*) string;
+        if(!*string) return 0;
+    }
+}
+
+char* strrchr(const char* string, int c) {
+    const char* found = 0;
+    for(;; string++) {
+        if(*string == (char) c) found = string;
+        if(!*string) return (char*) found;
+    }
+}
+
+char* strstr(const char* haystack, const char* needle) {
+    size_t length = strlen(needle);
+    for(; *haystack; haystack++) {
+        if(!strncmp(haystack, needle, length)) return (char*) haystack;
+    }
+    return length ? 0 : (char*) haystack;
+}
+
+size_t strspn(const char* string, const char* accept) {
+    size_t length = 0;
+    while(string[length] && strchr(accept, string[length])) length++;
+    return length;
+}
+
+size_t strcspn(const char* string, const char* reject) {
+    size_t length = 0;
+    while(string[length] && !strchr(reject, string[length])) length++;
+    return length;
+}
+
+char* strpbrk(const char* string, const char* accept) {
+    string += strcspn(string, accept);
+    return *string ? (char*) string : 0;
+}
+
+char* strerror(int error) {
+    switch(error) {
+        case 0: return "no error";
+        case ENOENT: return "no such file or directory";
+        case EINVAL: return "invalid argument";
+        case ERANGE: return "result out of range";
+        default: return "unknown error";
+    }
+}
+
+// --- stdlib.h ---
+
+// in front of every block, keeps the block 16 byte aligned
+typedef struct {
+    size_t size;
+    size_t padding;
+} block_header;
+
+void* malloc(size_t size) {
+    block_header* header = kmalloc(sizeof(block_header) + size);
+    if(!header) return 0;
+    header->size = size;
+    return header + 1;
+}
+
+void* calloc(size_t count, size_t size) {
+    if(size && count > (size_t) -1 / size) return 0;
+    void* block = malloc(count * size);
+    if(block) memset(block, 0, count * size);
+    return block;
+}
+
+void* realloc(void* pointer, size_t size) {
+    if(!pointer) return malloc(size);
+    if(!size) {
+        free(pointer);
+        return 0;
+    }
+    size_t old_size = ((block_header*) pointer - 1)->size;
+    void* block = malloc(size);
+    if(!block) return 0;
+    memcpy(block, pointer, old_size < size ? old_size : size);
+    free(pointer);
+    return block;
+}
+
+void free(void* pointer) {
+    if(pointer) kfree((block_header*) pointer - 1);
+}
+
+void abort() {
+    kprintf("\nabort() called\n");
+    term_flush();
+    while(1) asm volatile("cli; hlt");
+}
+
+// 10^n for n >= 0, in extended precision like kprintf's
+static long double power_of_ten(int n) {
+    long double result = 1;
+    long double power = 10;
+    while(n) {
+        if(n & 1) result *= power;
+        power *= power;
+        n >>= 1;
+    }
+    return result;
+}
+
+static int hex_value(int c) {
+    if(isdigit(c)) return c - '0';
+    return (c | 0x20) - 'a' + 10;
+}
+
+// the digits are scaled in long double, which lands within an ulp of the correctly rounded double
+// (not always on it, so printing with %.17g and reading it back isn't guaranteed to round trip)
+double strtod(const char* string, char** end) {
+    const char* s = string;
+    while(isspace(*s)) s++;
+    int negative = *s == '-';
+    if(*s == '-' || *s == '+') s++;
+
+    if((s[0] | 0x20) == 'i' && (s[1] | 0x20) == 'n' && (s[2] | 0x20) == 'f') {
+        s += 3;
+        if(!strncmp(s, "inity", 5) || !strncmp(s, "INITY", 5)) s += 5;
+        if(end) *end = (char*) s;
+        return negative ? -HUGE_VAL : HUGE_VAL;
+    }
+    if((s[0] | 0x20) == 'n' && (s[1] | 0x20) == 'a' && (s[2] | 0x20) == 'n') {
+        if(end) *end = (char*) s + 3;
+        return NAN;
+    }
+
+    int hex = s[0] == '0' && (s[1] | 0x20) == 'x' && (isxdigit(s[2]) || (s[2] == '.' && isxdigit(s[3])));
+    if(hex) s += 2;
+    int base = hex ? 16 : 10;
+    // the first 16 hex or 19 decimal significant digits are kept, the ones after that only move the exponent
+    int max_digits = hex ? 16 : 19;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;   // of the base, or of 2 for hex
+    int any = 0;
+    int point = 0;
+    for(;; s++) {
+        if(*s == '.' && !point) {
+            point = 1;
+            continue;
+        }
+        if(!(hex ? isxdigit(*s) : isdigit(*s))) break;
+        any = 1;
+        if(mantissa == 0 && hex_value(*s) == 0) { // leading zeros aren't significant
+            if(point) exponent -= hex ? 4 : 1;
+            continue;
+        }
+        if(digits < max_digits) {
+            mantissa = mantissa * base + hex_value(*s);
+            digits++;
+            if(point) exponent -= hex ? 4 : 1;
+        } else if(!point) {
+            exponent += hex ? 4 : 1;
+        }
+    }
+    if(!any) {
+        if(end) *end = (char*) string;
+        return 0;
+    }
+
+    if((*s | 0x20) == (hex ? 'p' : 'e')) {
+        const char* exponent_start = s++;
+        int exponent_negative = *s == '-';
+        if(*s == '-' || *s == '+') s++;
+        if(isdigit(*s)) {
+            int value = 0;
+            for(; isdigit(*s); s++) {
+                if(value < 100000) value = value * 10 + (*s - '0');
+            }
+            exponent += exponent_negative ? -value : value;
+        } else {
+            s = exponent_start; // "1e" is just 1
+        }
+    }
+    if(end) *end = (char*) s;
+
+    double value;
+    if(hex) {
+        value = ldexp((double) mantissa, exponent);
+    } else if(mantissa == 0 || exponent < -400) {
+        value = 0;
+    } else if(exponent > 400) {
+        value = HUGE_VAL;
+    } else {
+        long double scaled = mantissa;
+        // tiny results go in two steps, 10^-400 isn't a long double either
+        if(exponent < -300) {
+            scaled /= power_of_ten(300);
+            exponent += 300;
+        }
+        scaled = exponent >= 0 ? scaled * power_of_ten(exponent) : scaled / power_of_ten(-exponent);
+        value = scaled;
+    }
+    if(value == HUGE_VAL || (value == 0 && mantissa)) errno = ERANGE;
+    return negative ? -value : value;
+}
+
+// --- stdio.h ---
+
+FILE libc_stdin;
+FILE libc_stdout = { 1, 0 };
+FILE libc_stderr = { 1, 0 };
+
+FILE* fopen(const char* path, const char* mode) {
+    (void) path;
+    (void) mode;
+    errno = ENOENT;
+    return 0;
+}
+
+FILE* freopen(const char* path, const char* mode, FILE* file) {
+    (void) file;
+    return fopen(path, mode);
+}
+
+int fclose(FILE* file) {
+    (void) file;
+    return 0;
+}
+
+size_t fread(void* buffer, size_t size, size_t count, FILE* file) {
+    (void) buffer;
+    (void) size;
+    (void) count;
+    (void) file;
+    return 0;
+}
+
+size_t fwrite(const void* buffer, size_t size, size_t count, FILE* file) {
+    if(!file->writable) {
+        file->error = 1;
+        return 0;
+    }
+    term_writeBuffer(buffer, size * count);
+    return count;
+}
+
+int getc(FILE* file) {
+    (void) file;
+    return EOF;
+}
+
+int ungetc(int c, FILE* file) {
+    (void) c;
+    (void) file;
+    return EOF;
+}
+
+int fputs(const char* string, FILE* file) {
+    return fwrite(string, strlen(string), 1, file) ? 0 : EOF;
+}
+
+int fflush(FILE* file) {
+    (void) file;
+    return 0; // term_writeBuffer has already flushed
+}
+
+int ferror(FILE* file) {
+    return file->error;
+}
+
+int feof(FILE* file) {
+    return !file->writable;
+}
+
+void clearerr(FILE* file) {
+    file->error = 0;
+}
+
+static int write_formatted(FILE* file, const char* format, va_list args) {
+    char buffer[BUFSIZ];
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
+    if(length < (int) sizeof(buffer)) {
+        fwrite(buffer, length, 1, file);
+    } else { // too long for the stack, format it again on the heap
+        char* big = malloc(length + 1);
+        if(big) {
+            vsnprintf(big, length + 1, format, copy);
+            fwrite(big, length, 1, file);
+            free(big);
+        }
+    }
+    va_end(copy);
+    return length;
+}
+
+int fprintf(FILE* file, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = write_formatted(file, format, args);
+    va_end(args);
+    return length;
+}
+
+int printf(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = write_formatted(stdout, format, args);
+    va_end(args);
+    return length;
+}
+
+int snprintf(char* buffer, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = kvsnprintf(buffer, size, format, args);
+    va_end(args);
+    return length;
+}
+
+int vsnprintf(char* buffer, size_t size, const char* format, va_list args) {
+    return kvsnprintf(buffer, size, format, args);
+}
+
+// --- locale.h & time.h ---
+
+struct lconv* localeconv() {
+    static struct lconv c_locale = { "." };
+    return &c_locale;
+}
+
+time_t time(time_t* result) {
+    time_t now = time_now_ns() / 1000000000;
+    if(result) *result = now;
+    return now;
+}
+
+clock_t clock() {
+    return time_now_ns() / 1000;
+}
+
+// --- math.h ---
+
+typedef union {
+    double d;
+    uint64_t u;
+} double_bits;
+
+double fabs(double x) {
+    double_bits bits = { x };
+    bits.u &= ~(1ull << 63);
+    return bits.d;
+}
+
+double floor(double x) {
+    if(!(fabs(x) < 4503599627370496.0)) return x; // 2^52, nan & inf: already whole numbers
+    double whole = (double) (int64_t) x;
+    return whole > x ? whole - 1 : whole;
+}
+
+double ceil(double x) {
+    return -floor(-x);
+}
+
+double sqrt(double x) {
+    asm("sqrtsd %1, %0" : "=x"(x) : "x"(x));
+    return x;
+}
+
+double fmod(double x, double y) {
+    // fprem is exact, it just needs repeating when the exponents are far apart
+    long double result = x;
+    asm("1: fprem\n"
+        "   fnstsw %%ax\n"
+        "   testw $0x400, %%ax\n"
+        "   jnz 1b"
+        : "+t"(result) : "u"((long double) y) : "ax", "cc");
+    return result;
+}
+
+double frexp(double x, int* exponent) {
+    double_bits bits = { x };
+    int biased = (bits.u >> 52) & 0x7ff;
+    if(biased == 0) {
+        if(x == 0) {
+            *exponent = 0;
+            return x;
+        }
+        // subnormal, make it normal first
+        double result = frexp(x * 18446744073709551616.0, exponent); // 2^64
+        *exponent -= 64;
+        return result;
+    }
+    if(biased == 0x7ff) { // nan & inf
+        *exponent = 0;
+        return x;
+    }
+    *exponent = biased - 1022;
+    bits.u = (bits.u & ~(0x7ffull << 52)) | (1022ull << 52);
+    return bits.d;
+}
+
+// x * 2^exponent in extended precision, fscale takes care of overflow & subnormals
+static long double scale_by_two(long double x, long double exponent) {
+    asm("fscale" : "+t"(x) : "u"(exponent));
+    return x;
+}
+
+double ldexp(double x, int exponent) {
+    return scale_by_two(x, exponent);
+}
+
+// log2(x) * y, the one instruction all the logarithms are built from
+static long double y_log2_x(long double x, long double y) {
+    long double result;
+    asm("fyl2x" : "=t"(result) : "0"(x), "u"(y) : "st(1)");
+    return result;
+}
+
+double log(double x) {
+    return y_log2_x(x, 0.693147180559945309417232121458176568L); // ln(2)
+}
+
+double log2(double x) {
+    return y_log2_x(x, 1);
+}
+
+double log10(double x) {
+    return y_log2_x(x, 0.301029995663981195213738894724493027L); // log10(2)
+}
+
+// 2^x for any x: f2xm1 only takes -1..1, so the whole part is done with fscale
+static long double exp2_extended(long double x) {
+    if(x != x) return x;
+    if(x > 20000) return HUGE_VAL;
+    if(x < -20000) return 0;
+    long double whole;
+    asm("frndint" : "=t"(whole) : "0"(x));
+    long double fraction = x - whole;
+    asm("f2xm1" : "+t"(fraction));
+    return scale_by_two(fraction + 1, whole);
+}
+
+double exp(double x) {
+    return exp2_extended(x * 1.44269504088896340735992468100189214L); // log2(e)
+}
+
+double pow(double x, double y) {
+    if(y == 0 || x == 1) return 1;
+    if(x != x || y != y) return NAN;
+    if(x == -1 && fabs(y) == HUGE_VAL) return 1;
+
+    int odd_integer = 0;
+    if(floor(y) == y) {
+        // small whole powers by squaring, so things like 10^2 & 2^53 come out exact
+        if(fabs(y) <= 1024) {
+            int64_t n = (int64_t) fabs(y);
+            long double result = 1;
+            long double power = x;
+            while(n) {
+                if(n & 1) result *= power;
+                power *= power;
+                n >>= 1;
+            }
+            return y < 0 ? 1 / result : result;
+        }
+        odd_integer = fabs(y) < 9007199254740992.0 && fmod(y, 2) != 0; // 2^53, past that all doubles are even
+    }
+    if(x == 0) {
+        if(y < 0) return odd_integer ? 1 / x : HUGE_VAL;
+        return odd_integer ? x : 0;
+    }
+    if(x < 0) {
+        if(floor(y) != y) return NAN;
+        double magnitude = exp2_extended(y_log2_x(-x, y));
+        return odd_integer ? -magnitude : magnitude;
+    }
+    return exp2_extended(y_log2_x(x, y));
+}
+
+// fsin, fcos & fptan only take |x| < 2^63, which is already far past where doubles have any fraction left.
+// they reduce with a 66 bit pi, so right next to a multiple of pi the result is only accurate to about 1e-19
+double sin(double x) {
+    long double result = x;
+    if(fabs(x) < 9.2233720368547758e18) asm("fsin" : "+t"(result));
+    else result = NAN;
+    return result;
+}
+
+double cos(double x) {
+    long double result = x;
+    if(fabs(x) < 9.2233720368547758e18) asm("fcos" : "+t"(result));
+    else result = NAN;
+    return result;
+}
+
+double tan(double x) {
+    long double result = x;
+    if(fabs(x) < 9.2233720368547758e18) {
+        long double one;
+        asm("fptan" : "=t"(one), "=u"(result) : "0"(result)); // pushes a 1 on top of the result
+        (void) one;
+    } else {
+        result = NAN;
+    }
+    return result;
+}
+
+double atan2(double y, double x) {
+    long double result;
+    asm("fpatan" : "=t"(result) : "0"((long double) x), "u"((long double) y) : "st(1)");
+    return result;
+}
+
+double atan(double x) {
+    return atan2(x, 1);
+}
+
+double asin(double x) {
+    // 1 - x^2 as (1 - x)(1 + x) stays accurate near 1
+    long double extended = x;
+    long double cosine = (1 - extended) * (1 + extended);
+    if(cosine < 0) return NAN;
+    asm("fsqrt" : "+t"(cosine));
+    return atan2(x, cosine);
+}
+
+double acos(double x) {
+    long double extended = x;
+    long double sine = (1 - extended) * (1 + extended);
+    if(sine < 0) return NAN;
+    asm("fsqrt" : "+t"(sine));
+    return atan2(sine, x);
+}
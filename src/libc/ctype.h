@@ -0,0 +1,32 @@
+/* ctype.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  ASCII only, like the C locale
+ */
+
+#ifndef LIBC_CTYPE_H
+#define LIBC_CTYPE_H
+
+static inline int isdigit(int c) { return c >= '0' && c <= '9'; }
+static inline int islower(int c) { return c >= 'a' && c <= 'z'; }
+static inline int isupper(int c) { return c >= 'A' && c <= 'Z'; }
+static inline int isalpha(int c) { return islower(c) || isupper(c); }
+static inline int isalnum(int c) { return isalpha(c) || isdigit(c); }
+static inline int isxdigit(int c) { return isdigit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f'); }
+static inline int isspace(int c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+static inline int iscntrl(int c) { return (c >= 0 && c < ' ') || c == 0x7f; }
+static inline int isgraph(int c) { return c > ' ' && c < 0x7f; }
+static inline int isprint(int c) { return c >= ' ' && c < 0x7f; }
+static inline int ispunct(int c) { return isgraph(c) && !isalnum(c); }
+static inline int tolower(int c) { return isupper(c) ? c | 0x20 : c; }
+static inline int toupper(int c) { return islower(c) ? c & ~0x20 : c; }
+
+#endif
@@ -0,0 +1,45 @@
+/* math.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  mostly the x87's transcendental instructions, which work in extended precision
+  so the results are right to about the last bit of a double
+ */
+
+#ifndef LIBC_MATH_H
+#define LIBC_MATH_H
+
+#define HUGE_VAL (__builtin_huge_val())
+#define INFINITY (__builtin_inff())
+#define NAN      (__builtin_nanf(""))
+
+double fabs(double x);
+double floor(double x);
+double ceil(double x);
+double fmod(double x, double y);
+double sqrt(double x);
+double frexp(double x, int* exponent);
+double ldexp(double x, int exponent);
+
+double exp(double x);
+double log(double x);
+double log2(double x);
+double log10(double x);
+double pow(double x, double y);
+
+double sin(double x);
+double cos(double x);
+double tan(double x);
+double asin(double x);
+double acos(double x);
+double atan(double x);
+double atan2(double y, double x);
+
+#endif
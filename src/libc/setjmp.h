@@ -0,0 +1,25 @@
+/* setjmp.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#ifndef LIBC_SETJMP_H
+#define LIBC_SETJMP_H
+
+#include <stdint.h>
+
+// rbx, rbp, r12-r15, rsp & the return address
+typedef uint64_t jmp_buf[8];
+
+// in libc_asm.S
+__attribute__((returns_twice)) int setjmp(jmp_buf buffer);
+__attribute__((noreturn)) void longjmp(jmp_buf buffer, int value);
+
+#endif
@@ -0,0 +1,59 @@
+/* stdio.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  there's no filesystem: fopen always fails & stdin is always at its end.
+  stdout & stderr write to the terminal
+ */
+
+#ifndef LIBC_STDIO_H
+#define LIBC_STDIO_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#define EOF (-1)
+#define BUFSIZ 512
+
+typedef struct {
+    int writable;
+    int error;
+} FILE;
+
+extern FILE libc_stdin;
+extern FILE libc_stdout;
+extern FILE libc_stderr;
+#define stdin  (&libc_stdin)
+#define stdout (&libc_stdout)
+#define stderr (&libc_stderr)
+
+FILE* fopen(const char* path, const char* mode);
+FILE* freopen(const char* path, const char* mode, FILE* file);
+int fclose(FILE* file);
+size_t fread(void* buffer, size_t size, size_t count, FILE* file);
+size_t fwrite(const void* buffer, size_t size, size_t count, FILE* file);
+int getc(FILE* file);
+int ungetc(int c, FILE* file);
+int fputs(const char* string, FILE* file);
+int fflush(FILE* file);
+int ferror(FILE* file);
+int feof(FILE* file);
+void clearerr(FILE* file);
+
+__attribute__((format(printf, 2, 3)))
+int fprintf(FILE* file, const char* format, ...);
+__attribute__((format(printf, 1, 2)))
+int printf(const char* format, ...);
+// these are kprintf's formatter
+__attribute__((format(printf, 3, 4)))
+int snprintf(char* buffer, size_t size, const char* format, ...);
+int vsnprintf(char* buffer, size_t size, const char* format, va_list args);
+
+#endif
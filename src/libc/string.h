@@ -0,0 +1,42 @@
+/* string.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  the parts of the C library Lua uses, implemented in libc.c. only Lua is built against these headers,
+  the rest of the kernel uses mem.h & friends. memcpy & co. are the ones from mem.c
+ */
+
+#ifndef LIBC_STRING_H
+#define LIBC_STRING_H
+
+#include <stddef.h>
+
+void* memcpy(void* destination, const void* source, size_t length);
+void* memmove(void* destination, const void* source, size_t length);
+void* memset(void* destination, int value, size_t length);
+int memcmp(const void* a, const void* b, size_t length);
+void* memchr(const void* memory, int value, size_t length);
+
+size_t strlen(const char* string);
+int strcmp(const char* a, const char* b);
+int strncmp(const char* a, const char* b, size_t length);
+// there's only the C locale, so this is strcmp
+int strcoll(const char* a, const char* b);
+char* strcpy(char* destination, const char* source);
+char* strncpy(char* destination, const char* source, size_t length);
+char* strchr(const char* string, int c);
+char* strrchr(const char* string, int c);
+char* strstr(const char* haystack, const char* needle);
+char* strpbrk(const char* string, const char* accept);
+size_t strspn(const char* string, const char* accept);
+size_t strcspn(const char* string, const char* reject);
+char* strerror(int error);
+
+#endif
@@ -0,0 +1,26 @@
+/* time.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#ifndef LIBC_TIME_H
+#define LIBC_TIME_H
+
+#include <stdint.h>
+
+typedef int64_t time_t;
+typedef int64_t clock_t;
+#define CLOCKS_PER_SEC 1000000
+
+// there's no real time clock yet, both of these count from clock_init
+time_t time(time_t* result);
+clock_t clock();
+
+#endif
@@ -0,0 +1,94 @@
+/* lz4.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  the compressed kernel container, written by tools/lz4pack.c & read by the loader:
+  lz4_container_header, then segment_count lz4_container_segments, then the first headers_size bytes of the elf file
+  (its header & program headers, as is), then each segment's file contents as one lz4 block, in the same order.
+  a block is the raw lz4 block format (no frame): sequences of a token, literals, a 2 byte offset & a match length
+ */
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mem.h"
+
+#define LZ4_CONTAINER_MAGIC 0x345a4c4b // "KLZ4"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t segment_count;
+    uint64_t size;              // of the whole container, so it can be read in one go
+    uint64_t headers_size;
+} lz4_container_header;
+
+typedef struct {
+    uint64_t vaddr;             // where the segment goes, like p_vaddr
+    uint64_t size;              // p_filesz, the decompressed size
+    uint64_t compressed_size;
+} lz4_container_segment;
+
+static inline uint64_t lz4_headersOffset(const lz4_container_header* header) {
+    return sizeof(lz4_container_header) + header->segment_count * sizeof(lz4_container_segment);
+}
+
+// adds the 255, 255, ..., n bytes that extend a length which filled its 4 bits of the token
+static inline int lz4_readLength(const uint8_t** in, const uint8_t* in_end, uint64_t* length) {
+    uint8_t byte;
+    do {
+        if(*in >= in_end) return 0;
+        byte = *(*in)++;
+        *length += byte;
+    } while(byte == 255);
+    return 1;
+}
+
+// decompresses one block. returns the decompressed size, or -1 if the block is corrupt or doesn't fit.
+// matches far enough back are copied 16 bytes at a time, which can write up to 15 bytes past the match
+// (but never past destination_size), later sequences overwrite them
+static inline int64_t lz4_decompress(const uint8_t* source, uint64_t source_size, uint8_t* destination, uint64_t destination_size) {
+    const uint8_t* in = source;
+    const uint8_t* in_end = source + source_size;
+    uint8_t* out = destination;
+    uint8_t* out_end = destination + destination_size;
+    while(in < in_end) {
+        uint8_t token = *in++;
+        uint64_t literals = token >> 4;
+        if(literals == 15 && !lz4_readLength(&in, in_end, &literals)) return -1;
+        if(literals > (uint64_t) (in_end - in) || literals > (uint64_t) (out_end - out)) return -1;
+        memcpy(out, in, literals);
+        in += literals;
+        out += literals;
+        if(in == in_end) break; // the last sequence is only literals
+
+        if(in_end - in < 2) return -1;
+        uint64_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        if(offset == 0 || offset > (uint64_t) (out - destination)) return -1;
+        uint64_t length = (token & 15) + 4;
+        if((token & 15) == 15 && !lz4_readLength(&in, in_end, &length)) return -1;
+        if(length > (uint64_t) (out_end - out)) return -1;
+
+        const uint8_t* match = out - offset;
+        if(offset >= 16 && length + 15 <= (uint64_t) (out_end - out)) {
+            for(uint64_t i = 0; i < length; i += 16) memcpy(out + i, match + i, 16);
+        } else {
+            // overlapping, this repeats the last offset bytes
+            for(uint64_t i = 0; i < length; i++) out[i] = match[i];
+        }
+        out += length;
+    }
+    return out - destination;
+}
+
+#endif
@@ -0,0 +1,233 @@
+/* mem.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+// otherwise gcc "optimizes" the byte loops below into calls to memset/memcpy (which are these functions)
+#pragma GCC optimize ("no-tree-loop-distribute-patterns")
+
+#include <stddef.h>
+#include <stdint.h>
+#include <immintrin.h>
+
+#include "cpu.h"
+#include "mem.h"
+
+// picked by a switch instead of function pointers, so every call is direct
+enum {
+    MEM_SSE2,
+    MEM_AVX2,
+    MEM_ERMS
+};
+static uint8_t mem_variant = MEM_SSE2;
+
+// rep movsb/stosb take a while to get going, below this the vector loops are faster
+#define ERMS_THRESHOLD 256
+
+// --- SSE2 (every x86-64 cpu has it) ---
+
+static void set_sse2(uint8_t* destination, uint8_t value, size_t length) {
+    if(length < 16) {
+        while(length--) *destination++ = value;
+        return;
+    }
+    __m128i v = _mm_set1_epi8(value);
+    uint8_t* end = destination + length;
+    _mm_storeu_si128((__m128i*) destination, v);   // unaligned head
+    uint8_t* p = (uint8_t*) (((uintptr_t) destination + 16) & ~(uintptr_t) 15);
+    for(; p + 32 <= end; p += 32) {
+        _mm_store_si128((__m128i*) p, v);
+        _mm_store_si128((__m128i*) (p + 16), v);
+    }
+    for(; p + 16 <= end; p += 16) {
+        _mm_store_si128((__m128i*) p, v);
+    }
+    _mm_storeu_si128((__m128i*) (end - 16), v);    // unaligned tail, overlapping what's already set
+}
+
+static void copy_sse2(uint8_t* destination, const uint8_t* source, size_t length) {
+    if(length < 16) {
+        while(length--) *destination++ = *source++;
+        return;
+    }
+    uint8_t* end = destination + length;
+    __m128i tail = _mm_loadu_si128((__m128i*) (source + length - 16));
+    _mm_storeu_si128((__m128i*) destination, _mm_loadu_si128((__m128i*) source));
+    size_t skip = 16 - ((uintptr_t) destination & 15);
+    uint8_t* p = destination + skip;
+    const uint8_t* s = source + skip;
+    for(; p + 32 <= end; p += 32, s += 32) {
+        __m128i a = _mm_loadu_si128((__m128i*) s);
+        __m128i b = _mm_loadu_si128((__m128i*) (s + 16));
+        _mm_store_si128((__m128i*) p, a);
+        _mm_store_si128((__m128i*) (p + 16), b);
+    }
+    for(; p + 16 <= end; p += 16, s += 16) {
+        _mm_store_si128((__m128i*) p, _mm_loadu_si128((__m128i*) s));
+    }
+    _mm_storeu_si128((__m128i*) (end - 16), tail);
+}
+
+// --- AVX2 ---
+
+__attribute__((target("avx2")))
+static void set_avx2(uint8_t* destination, uint8_t value, size_t length) {
+    if(length < 32) {
+        set_sse2(destination, value, length);
+        return;
+    }
+    __m256i v = _mm256_set1_epi8(value);
+    uint8_t* end = destination + length;
+    _mm256_storeu_si256((__m256i*) destination, v);
+    uint8_t* p = (uint8_t*) (((uintptr_t) destination + 32) & ~(uintptr_t) 31);
+    for(; p + 64 <= end; p += 64) {
+        _mm256_store_si256((__m256i*) p, v);
+        _mm256_store_si256((__m256i*) (p + 32), v);
+    }
+    for(; p + 32 <= end; p += 32) {
+        _mm256_store_si256((__m256i*) p, v);
+    }
+    _mm256_storeu_si256((__m256i*) (end - 32), v);
+    _mm256_zeroupper();
+}
+
+__attribute__((target("avx2")))
+static void copy_avx2(uint8_t* destination, const uint8_t* source, size_t length) {
+    if(length < 32) {
+        copy_sse2(destination, source, length);
+        return;
+    }
+    uint8_t* end = destination + length;
+    __m256i tail = _mm256_loadu_si256((__m256i*) (source + length - 32));
+    _mm256_storeu_si256((__m256i*) destination, _mm256_loadu_si256((__m256i*) source));
+    size_t skip = 32 - ((uintptr_t) destination & 31);
+    uint8_t* p = destination + skip;
+    const uint8_t* s = source + skip;
+    for(; p + 64 <= end; p += 64, s += 64) {
+        __m256i a = _mm256_loadu_si256((__m256i*) s);
+        __m256i b = _mm256_loadu_si256((__m256i*) (s + 32));
+        _mm256_store_si256((__m256i*) p, a);
+        _mm256_store_si256((__m256i*) (p + 32), b);
+    }
+    for(; p + 32 <= end; p += 32, s += 32) {
+        _mm256_store_si256((__m256i*) p, _mm256_loadu_si256((__m256i*) s));
+    }
+    _mm256_storeu_si256((__m256i*) (end - 32), tail);
+    _mm256_zeroupper();
+}
+
+// --- ERMS (enhanced rep movsb/stosb) ---
+
+static void set_erms(uint8_t* destination, uint8_t value, size_t length) {
+    if(length < ERMS_THRESHOLD) {
+        set_sse2(destination, value, length);
+        return;
+    }
+    asm volatile("rep stosb" : "+D"(destination), "+c"(length) : "a"(value) : "memory");
+}
+
+static void copy_erms(uint8_t* destination, const uint8_t* source, size_t length) {
+    if(length < ERMS_THRESHOLD) {
+        copy_sse2(destination, source, length);
+        return;
+    }
+    asm volatile("rep movsb" : "+D"(destination), "+S"(source), "+c"(length) : : "memory");
+}
+
+void mem_init() {
+    cpuid_result leaf1 = cpu_cpuid(1, 0);
+    cpuid_result leaf7 = { 0, 0, 0, 0 };
+    if(cpu_maxLeaf(0) >= 7) {
+        leaf7 = cpu_cpuid(7, 0);
+    }
+
+    // rep stosb/movsb are as fast as vector loops for big lengths, and don't need the vector registers at all
+    if(leaf7.ebx & CPUID_7_EBX_ERMS) {
+        mem_variant = MEM_ERMS;
+    } else if((leaf7.ebx & CPUID_7_EBX_AVX2) && (leaf1.ecx & CPUID_1_ECX_OSXSAVE)
+      && (cpu_readXcr(0) & (XCR0_SSE | XCR0_AVX)) == (XCR0_SSE | XCR0_AVX)) {
+        mem_variant = MEM_AVX2;
+    } else {
+        mem_variant = MEM_SSE2;
+    }
+}
+
+char* mem_variantName() {
+    switch(mem_variant) {
+        case MEM_AVX2: return "AVX2";
+        case MEM_ERMS: return "ERMS";
+        default:       return "SSE2";
+    }
+}
+
+void* memset(void* destination, int value, size_t length) {
+    switch(mem_variant) {
+        case MEM_AVX2: set_avx2(destination, value, length); break;
+        case MEM_ERMS: set_erms(destination, value, length); break;
+        default:       set_sse2(destination, value, length); break;
+    }
+    return destination;
+}
+
+void memzero(void* address, size_t length) {
+    memset(address, 0, length);
+}
+
+void* memcpy(void* destination, const void* source, size_t length) {
+    switch(mem_variant) {
+        case MEM_AVX2: copy_avx2(destination, source, length); break;
+        case MEM_ERMS: copy_erms(destination, source, length); break;
+        default:       copy_sse2(destination, source, length); break;
+    }
+    return destination;
+}
+
+// the memcpy variants read the tail before the body, so they only work if the ranges don't overlap
+void* memmove(void* destination, const void* source, size_t length) {
+    uint8_t* d = destination;
+    const uint8_t* s = source;
+    if(d + length <= s || s + length <= d) {
+        return memcpy(destination, source, length);
+    }
+
+    if(d < s) { // copy forwards, every chunk is loaded before the store that could overwrite it
+        for(; length >= 16; length -= 16, d += 16, s += 16) {
+            _mm_storeu_si128((__m128i*) d, _mm_loadu_si128((__m128i*) s));
+        }
+        while(length--) *d++ = *s++;
+    } else {    // copy backwards
+        d += length;
+        s += length;
+        for(; length >= 16; length -= 16) {
+            d -= 16;
+            s -= 16;
+            _mm_storeu_si128((__m128i*) d, _mm_loadu_si128((__m128i*) s));
+        }
+        while(length--) *--d = *--s;
+    }
+    return destination;
+}
+
+int memcmp(const void* a, const void* b, size_t length) {
+    const uint8_t* x = a;
+    const uint8_t* y = b;
+    for(; length >= 16; length -= 16, x += 16, y += 16) {
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((__m128i*) x), _mm_loadu_si128((__m128i*) y));
+        uint32_t mask = _mm_movemask_epi8(equal) ^ 0xffff;
+        if(mask) {
+            int i = __builtin_ctz(mask);
+            return x[i] - y[i];
+        }
+    }
+    for(; length > 0; length--, x++, y++) {
+        if(*x != *y) return *x - *y;
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+/* mem.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  freestanding memset & friends, shared by the loader and the kernel.
+  the SSE2 versions are used until mem_init picks the best ones for this cpu.
+ */
+
+#ifndef MEM_H
+#define MEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// checks CPUID once. AVX2 is only used if the OS has already enabled AVX state (see cpu_enableAvx)
+void mem_init();
+// name of the variant mem_init picked, for printing
+char* mem_variantName();
+
+void* memset(void* destination, int value, size_t length);
+void* memcpy(void* destination, const void* source, size_t length);
+void* memmove(void* destination, const void* source, size_t length);
+int memcmp(const void* a, const void* b, size_t length);
+void memzero(void* address, size_t length);
+
+#endif
@@ -12,16 +12,22 @@
 
 #include <stdint.h>
 
+#include "cpu.h"
+#include "mem.h"
 #include "term.h"
+#include "kprintf.h"
+#include "klog.h"
+#include "spinlock.h"
+#include "percpu.h"
+#include "timeline.h"
 #include "uefi_loader.h"
+#include "frame_allocator.h"
+#include "paging.h"
+#include "phys.h"
+#include "interrupts.h"
+#include "vm.h"
 #include "memory_manager.h"
 
-void memzero(uint8_t* address, int length) {
-    for(int i = 0; i < length; i++) {
-        address[i] = 0;
-    }
-}
-
 enum {
     EfiReservedMemoryType,
     EfiLoaderCode,
@@ -40,6 +46,21 @@ enum {
     EfiMaxMemoryType
 };
 
+// memory the kernel may use once it's done with the firmware & loader
+static int is_usable_memory(uint32_t type) {
+    return type == EfiConventionalMemory
+        || type == EfiBootServicesCode || type == EfiBootServicesData
+        || type == EfiLoaderCode || type == EfiLoaderData;
+}
+
+// memory that is mapped before the kernel switches page tables: ram, the kernel itself, and what the firmware left for the OS
+// (ACPI tables & runtime services). reserved ranges & MMIO are left out, drivers map what they use with memory_mapMMIO
+static int needs_early_mapping(uint32_t type) {
+    return is_usable_memory(type) || type == KERNEL_MEMORY_TYPE
+        || type == EfiACPIReclaimMemory || type == EfiACPIMemoryNVS
+        || type == EfiRuntimeServicesCode || type == EfiRuntimeServicesData;
+}
+
 typedef struct {
     uint32_t type;
     uint32_t _padding;
@@ -49,208 +70,397 @@ typedef struct {
     uint64_t attribute;
 } uefi_memory_descriptor;
 
+__attribute__((aligned(PAGE_SIZE)))
+uint64_t pml4_table[PAGE_TABLE_ENTRY_COUNT];
 
-// --- Global Descriptor Table ---
-#pragma pack (1)
+extern void load_page_map_level_4(uint64_t* pml4);
 
-struct gdt_entry {
-  uint16_t limit15_0;            uint16_t base15_0;
-  uint8_t  base23_16;            uint8_t  type;
-  uint8_t  limit19_16_and_flags; uint8_t  base31_24;
-};
+// usable regions that can't be freed until the kernel is off the loader's stack & done with loader_data
+#define MAX_DEFERRED_REGIONS 32
+static struct {
+    uint64_t address;
+    uint64_t page_count;
+} deferred_regions[MAX_DEFERRED_REGIONS];
+static int deferred_region_count;
 
-struct tss {
-    uint32_t reserved0; uint64_t rsp0;      uint64_t rsp1;
-    uint64_t rsp2;      uint64_t reserved1; uint64_t ist1;
-    uint64_t ist2;      uint64_t ist3;      uint64_t ist4;
-    uint64_t ist5;      uint64_t ist6;      uint64_t ist7;
-    uint64_t reserved2; uint16_t reserved3; uint16_t iopb_offset;
-} tss;
-
-__attribute__((aligned(4096)))
-struct {
-  struct gdt_entry null;
-  struct gdt_entry kernel_code;
-  struct gdt_entry kernel_data;
-  struct gdt_entry null2;
-  struct gdt_entry user_data;
-  struct gdt_entry user_code;
-  struct gdt_entry ovmf_data;
-  struct gdt_entry ovmf_code;
-  struct gdt_entry tss_low;
-  struct gdt_entry tss_high;
-} gdt_table = {
-//            type  flags
-    {0, 0, 0,    0,    0, 0},  /* 0x00 null  */
-    {0, 0, 0, 0x9A, 0xA0, 0},  /* 0x08 kernel code (kernel base selector) */
-    {0, 0, 0, 0x92, 0xA0, 0},  /* 0x10 kernel data */
-    {0, 0, 0,    0,    0, 0},  /* 0x18 null (user base selector) */
-    {0, 0, 0, 0x92, 0xA0, 0},  /* 0x20 user data */
-    {0, 0, 0, 0x9A, 0xA0, 0},  /* 0x28 user code */
-    {0, 0, 0, 0x92, 0xA0, 0},  /* 0x30 ovmf data */
-    {0, 0, 0, 0x9A, 0xA0, 0},  /* 0x38 ovmf code */
-    {0, 0, 0, 0x89, 0xA0, 0},  /* 0x40 tss low */
-    {0, 0, 0,    0,    0, 0},  /* 0x48 tss high */
-// type  0x9A = 1001_1010 = present,  privilege level 0,  user (for code)    ; code, not conforming, [readable, not accessed]
-// type  0x92 = 1001_0010 = present, [privilege level 0], user (for data)    ; data, [not expand down, writable, not accessed]
-// type  0x89 = 1000_1001 = present,  privilege level 0, system (for TSS)    ; available 64-bit TSS
-// flags 0xA0 = 1010_0000 = [granularity = 4KiB], long mode (D0, L1), unused ; [segment limit = 0]
-//                          "long mode" bits ignored by data & TSS segments
-// brackets indicate bits that are ignored in long mode
-};
+// MEMORY_LOW_PAGES pages below 1 MiB, kept out of the frame allocator for code that starts in real mode
+static uint64_t low_memory;
 
-struct table_ptr {
-    uint16_t limit;
-    uint64_t base;
-};
-#pragma pack ()
-
-extern void load_gdt(struct table_ptr* gdt_ptr);
-
-static void setup_gdt() {
-    memzero((void*)&tss, sizeof(tss));
-    uint64_t tss_base = ((uint64_t)&tss);
-    gdt_table.tss_low.base15_0 = tss_base & 0xffff;
-    gdt_table.tss_low.base23_16 = (tss_base >> 16) & 0xff;
-    gdt_table.tss_low.base31_24 = (tss_base >> 24) & 0xff;
-    gdt_table.tss_low.limit15_0 = sizeof(tss);
-    // base 32-63
-    gdt_table.tss_high.limit15_0 = (tss_base >> 32) & 0xffff;
-    gdt_table.tss_high.base15_0 = (tss_base >> 48) & 0xffff;
-
-    struct table_ptr gdt_ptr = { sizeof(gdt_table)-1, (uint64_t)&gdt_table };
-    load_gdt(&gdt_ptr);
-}
+spinlock memory_lock;
 
-// --- Page Table ---
+uint64_t phys_offset;
 
-#define PAGE_SIZE 4096
+// ram gets mapped twice: at its own address (where the kernel & loader data are), and in the direct map for phys_to_virt
+static void map_ram(uint64_t begin, uint64_t end) {
+    if(begin >= end) return;
+    paging_identityMap(pml4_table, begin, end, MEMORY_CACHE_WRITE_BACK);
+    paging_map(pml4_table, PHYS_DIRECT_MAP + begin, begin, end - begin, PAGE_WRITABLE, MEMORY_CACHE_WRITE_BACK);
+}
 
-#define PAGE_TABLE_ENTRY_COUNT 512
-// page-aligned 52-bit address
-#define PAGE_ADDRESS_MASK 0x000ffffffffff000
+static void defer_region(uint64_t address, uint64_t page_count) {
+    if(deferred_region_count < MAX_DEFERRED_REGIONS) {
+        deferred_regions[deferred_region_count].address = address;
+        deferred_regions[deferred_region_count].page_count = page_count;
+        deferred_region_count++;
+    } // else, the region just stays unused
+}
 
-#define PAGE_PRESENT    (1<<0)
-#define PAGE_WRITABLE   (1<<1)
-#define PAGE_USER       (1<<2)
-#define PAGE_NO_EXECUTE (1<<63)
+static int has_pat;
+
+// address space handed out by memory_reserve, far above any physical memory (and so any identity mapping)
+#define RESERVATION_BASE 0x0000400000000000
+#define MAX_RESERVATIONS 64
+static struct {
+    uint64_t begin;
+    uint64_t end;
+    memory_cache_type cache_type;
+} reservations[MAX_RESERVATIONS];
+static int reservation_count;
+static uint64_t reservation_next = RESERVATION_BASE;
+static uint64_t committed_pages;
+
+// PAT entries 0-3 are what they were without a PAT (WB, WT, UC-, UC), except entry 1 is write-combining instead of WT.
+// WT moves to entry 7, so the index of each type is its value in memory_cache_type
+#define PAT_VALUE ( \
+      (0x06ull << 0)  /* WB  */ \
+    | (0x01ull << 8)  /* WC  */ \
+    | (0x07ull << 16) /* UC- */ \
+    | (0x00ull << 24) /* UC  */ \
+    | (0x06ull << 32) /* WB  */ \
+    | (0x05ull << 40) /* WP  */ \
+    | (0x07ull << 48) /* UC- */ \
+    | (0x04ull << 56) /* WT  */ )
+
+static void setup_pat() {
+    has_pat = (cpu_cpuid(1, 0).edx & CPUID_1_EDX_PAT) != 0;
+    if(!has_pat) return;
+    // nothing is mapped with the PAT bits yet, but there might be cached lines of memory that are about to change type
+    asm volatile("wbinvd" : : : "memory");
+    cpu_writeMsr(MSR_IA32_PAT, PAT_VALUE);
+}
 
-__attribute__((aligned(PAGE_SIZE)))
-uint64_t pml4_table[PAGE_TABLE_ENTRY_COUNT];
+void memory_initCpu() {
+    if(has_pat) cpu_writeMsr(MSR_IA32_PAT, PAT_VALUE); // every cpu has to agree on what the PAT indices mean
+    vm_initCpu();
+}
 
-extern void load_page_map_level_4(uint64_t* pml4);
+uint64_t* memory_pageMap() {
+    return pml4_table;
+}
 
-static uint64_t next_page;
-static uint64_t get_next_page() {
-    uint64_t page = next_page;
-    next_page += PAGE_SIZE;
-    return page;
+uint64_t memory_lowMemory() {
+    return low_memory;
 }
 
+// only this cpu's TLB is flushed, so this is only safe for ranges the other cpus haven't touched yet
+void memory_mapMMIO(uint64_t address, uint64_t size, memory_cache_type cache_type) {
+    uint64_t begin = address & ~(uint64_t)(PAGE_SIZE - 1);
+    uint64_t end = (address + size + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+    vm_map(vm_kernelSpace(), begin, begin, end - begin, VM_WRITABLE | VM_NO_EXECUTE, cache_type);
+}
 
-static void identity_map_page(uint64_t logical_address) {
-    uint64_t flags = PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER;
-
-    uint64_t pml4_index = (logical_address >> 39) & 0x1ff;
-    uint64_t pdp_index = (logical_address >> 30) & 0x1ff;
-    uint64_t pd_index = (logical_address >> 21) & 0x1ff;
-    uint64_t pt_index = (logical_address >> 12) & 0x1ff;
-
-    if(!(pml4_table[pml4_index] & PAGE_PRESENT)) {
-        uint64_t pdp_allocation = get_next_page();
-        memzero((void*) pdp_allocation, PAGE_SIZE);
-        pml4_table[pml4_index] = (pdp_allocation & PAGE_ADDRESS_MASK) | flags;
-        // make sure the page we just allocated is itself mapped & accessable
-        // TODO: after switching to our page map, this will fail once the last page in a
-        // page table is allocated, since the next page table will be accessed through itself
-        // and we can't write to it until after it's mapped (i think)
-        // need to allocate the next table when filling the 511th entry (so 512th entry is used to map the next table)
-        identity_map_page(pdp_allocation);
+void* memory_reserve(uint64_t size, memory_cache_type cache_type) {
+    size = (size + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+    void* address = 0;
+    spinlock_acquire(&memory_lock);
+    if(reservation_count < MAX_RESERVATIONS && size) {
+        reservations[reservation_count].begin = reservation_next;
+        reservations[reservation_count].end = reservation_next + size;
+        reservations[reservation_count].cache_type = cache_type;
+        // page_fault looks reservations up without the lock, so the entry has to be filled in before it's counted
+        __atomic_store_n(&reservation_count, reservation_count + 1, __ATOMIC_RELEASE);
+        address = (void*) reservation_next;
+        reservation_next += size + PAGE_SIZE; // leave an unmapped guard page, so running off the end faults
     }
+    spinlock_release(&memory_lock);
+    return address;
+}
 
-    uint64_t* pdp_table = (uint64_t*) (pml4_table[pml4_index] & PAGE_ADDRESS_MASK);
+uint64_t memory_committedPages() {
+    return committed_pages;
+}
 
-    if(!(pdp_table[pdp_index] & PAGE_PRESENT)) {
-        uint64_t pdt_allocation = get_next_page();
-        memzero((void*) pdt_allocation, PAGE_SIZE);
-        pdp_table[pdp_index] = (pdt_allocation & PAGE_ADDRESS_MASK) | flags;
-        identity_map_page(pdt_allocation);
+// reservations are only ever added, so this is safe without the lock
+static int find_reservation(uint64_t address) {
+    int count = __atomic_load_n(&reservation_count, __ATOMIC_ACQUIRE);
+    for(int i = 0; i < count; i++) {
+        if(address >= reservations[i].begin && address < reservations[i].end) return i;
     }
+    return -1;
+}
 
-    uint64_t* pd_table = (uint64_t*) (pdp_table[pdp_index] & PAGE_ADDRESS_MASK);
-
-    if(!(pd_table[pd_index] & PAGE_PRESENT)) {
-        uint64_t pd_allocation = get_next_page();
-        memzero((void*) pd_allocation, PAGE_SIZE);
-        pd_table[pd_index] = (pd_allocation & PAGE_ADDRESS_MASK) | flags;
-        identity_map_page(pd_allocation);
+static void* cache_allocate();
+static int cache_free(uint64_t frame);
+
+#define PAGE_FAULT_PRESENT (1 << 0) // the page was mapped, so it was a protection fault
+
+// backs the page in a reservation on first touch, anything else is a real fault
+static void page_fault(interrupt_frame* frame) {
+    uint64_t address;
+    asm volatile("mov %%cr2, %0" : "=r"(address));
+    address &= ~(uint64_t)(PAGE_SIZE - 1);
+    if(frame->error_code & PAGE_FAULT_PRESENT) interrupts_fatal(frame);
+    // checked before anything else, so a wild access (or one while this cpu holds memory_lock) is reported right away
+    int reservation = find_reservation(address);
+    if(reservation < 0) interrupts_fatal(frame);
+
+    // zero the page before taking the lock, it's the slow part
+    void* page = cache_allocate();
+    if(!page) interrupts_fatal(frame);
+    memzero(page, PAGE_SIZE);
+
+    spinlock_acquire(&memory_lock);
+    // another cpu may have faulted on the same page first
+    int raced = paging_translate(pml4_table, address) != PAGING_NOT_MAPPED;
+    if(!raced) {
+        // a not-present entry is never cached in the TLB, so there's nothing to flush
+        paging_map(pml4_table, address, virt_to_phys(page), PAGE_SIZE, PAGE_WRITABLE, reservations[reservation].cache_type);
+        committed_pages++;
     }
+    // the reservation's top-level entry is only created in the kernel's page map, so a space that was
+    // copied from it before then doesn't have it yet (and would fault here forever)
+    // compared physically, pml4_table is an identity mapped pointer and phys_to_virt gives a direct map one
+    uint64_t current_pml4 = cpu_readCr3() & PAGE_ADDRESS_MASK;
+    uint64_t slot = (address >> 39) & 0x1ff;
+    if(current_pml4 != virt_to_phys(pml4_table)) {
+        uint64_t* current = phys_to_virt(current_pml4);
+        if(!(current[slot] & PAGE_PRESENT)) current[slot] = pml4_table[slot];
+    }
+    spinlock_release(&memory_lock);
 
-    uint64_t* page_table = (uint64_t*) (pd_table[pd_index] & PAGE_ADDRESS_MASK);
-
-    if(!(page_table[pt_index] & PAGE_PRESENT)) {
-        page_table[pt_index] = (logical_address & PAGE_ADDRESS_MASK) | flags;
-    } // else, this page was already mapped (?)
+    if(raced) cache_free(virt_to_phys(page));
 }
 
 void memory_init(loader_data* loader_data) {
-    asm("cli");
-    term_write("interrupts off\n");
+    kprintf("mem map desc size: %lu\n", loader_data->memory_descriptor_size);
 
-    setup_gdt();
-    term_write("setup gdt\n");
+    // the frame allocator tracks every frame between the lowest and highest usable address
+    uint64_t usable_begin = -1;
+    uint64_t usable_end = 0;
+    uint8_t* memory_map = loader_data->memory_map;
+    for (uint64_t i = 0; i < loader_data->memory_map_size; i += loader_data->memory_descriptor_size) {
+        uefi_memory_descriptor* desc = (uefi_memory_descriptor*) &memory_map[i];
+        if(!is_usable_memory(desc->type)) continue;
+        uint64_t end = desc->physical_start + (desc->page_count * PAGE_SIZE);
+        if(desc->physical_start < usable_begin) usable_begin = desc->physical_start;
+        if(end > usable_end) usable_end = end;
+    }
 
-    term_write("mem map desc size: ");
-    term_writeNumber(loader_data->memory_descriptor_size);
-    term_write("\n");
+    // the metadata goes at the start of the first conventional memory region big enough to hold it
+    uint64_t metadata_pages = (frame_metadataSize(usable_begin, usable_end) + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint64_t metadata_address = 0;
+    for (uint64_t i = 0; i < loader_data->memory_map_size; i += loader_data->memory_descriptor_size) {
+        uefi_memory_descriptor* desc = (uefi_memory_descriptor*) &memory_map[i];
+        if(desc->type != EfiConventionalMemory || desc->physical_start == 0) continue;
+        if(desc->page_count >= metadata_pages) {
+            metadata_address = desc->physical_start;
+            break;
+        }
+    }
+    if(!metadata_address) {
+        term_write("no room for the frame allocator metadata!\n");
+        term_flush();
+        while(1);
+    }
+    frame_init(phys_to_virt(metadata_address), usable_begin, usable_end);
 
-    uint64_t max_page_start = 0;
-    uint64_t max_page_count = 0;
-    uint8_t* memory_map = loader_data->memory_map;
+    // only conventional memory is free right now. boot services memory still holds the firmware's page tables
     for (uint64_t i = 0; i < loader_data->memory_map_size; i += loader_data->memory_descriptor_size) {
         uefi_memory_descriptor* desc = (uefi_memory_descriptor*) &memory_map[i];
         if(desc->type != EfiConventionalMemory) continue;
-        if(desc->page_count > max_page_count) {
-            max_page_count = desc->page_count;
-            max_page_start = desc->physical_start;
+        uint64_t start = desc->physical_start;
+        uint64_t end = start + desc->page_count * PAGE_SIZE;
+        if(start == metadata_address) start += metadata_pages * PAGE_SIZE;
+        // page 0 is never handed out, so it can't be low memory either
+        uint64_t low = start ? start : PAGE_SIZE;
+        if(!low_memory && low + MEMORY_LOW_PAGES * PAGE_SIZE <= end && low + MEMORY_LOW_PAGES * PAGE_SIZE <= 0x100000) {
+            low_memory = low;
+            start = low + MEMORY_LOW_PAGES * PAGE_SIZE;
         }
+        frame_addRegion(start, (end - start) / PAGE_SIZE);
     }
 
-    next_page = max_page_start;
+    timeline_phase("frame allocator");
 
-    term_write("largest page start: ");
-    term_writeHex64(max_page_start);
-    term_write("\ncount: ");
-    term_writeHex64(max_page_count);
-    term_write("\n");
+    kprintf("frame metadata: 0x%lx, %lu pages\n", metadata_address, metadata_pages);
 
-    // TODO: identity map all of the UEFI sections that need to be preserved at runtime
-    // for now, just identity map everything in the UEFI memory map.
-    // our "OS Loader" code (that is running right now) is in one of these sections, but we don't know which
+    // 2 MiB pages are always there in long mode, but check anyways. 1 GiB pages are optional
+    int has_2m_pages = (cpu_cpuid(1, 0).edx & CPUID_1_EDX_PSE) != 0;
+    int has_1g_pages = cpu_maxLeaf(0x80000000) >= 0x80000001
+        && (cpu_cpuid(0x80000001, 0).edx & CPUID_80000001_EDX_PDPE1GB) != 0;
+    setup_pat();
+    paging_init(has_2m_pages, has_1g_pages, has_pat);
+
+    // map ram & the kernel. our "OS Loader" code (that is running right now) is in one of these sections, but we don't know which.
+    // neighbouring descriptors are joined into one range first so only the ends of each run need 4 KiB pages
+    uint64_t run_begin = 0;
+    uint64_t run_end = 0;
     for (uint64_t i = 0; i < loader_data->memory_map_size; i += loader_data->memory_descriptor_size) {
         uefi_memory_descriptor* desc = (uefi_memory_descriptor*) &memory_map[i];
-        // uint32_t type = desc->Type;
+        if(!needs_early_mapping(desc->type)) continue;
         uint64_t end = desc->physical_start + (desc->page_count * PAGE_SIZE);
-        for (uint64_t page = desc->physical_start; page < end; page += PAGE_SIZE) {
-            identity_map_page(page);
+        if(desc->physical_start != run_end) {
+            map_ram(run_begin, run_end);
+            run_begin = desc->physical_start;
         }
+        run_end = end;
     }
+    map_ram(run_begin, run_end);
 
-    // map the framebuffer too, so we can still print to it (interestingly, the framebuffer is not mentioned in the UEFI memory map)
+    // map the framebuffer too, so we can still print to it (interestingly, the framebuffer is not mentioned in the UEFI memory map).
+    // write-combining lets the cpu merge the stores into full bursts, instead of whatever the firmware's MTRRs say (usually UC)
     uint64_t framebuffer_address = (uint64_t) loader_data->framebuffer;
-    uint64_t framebuffer_page_count = (loader_data->framebuffer_pixels_per_line * loader_data->framebuffer_height) * 4 / PAGE_SIZE;
-    for(uint64_t i = 0; i < framebuffer_page_count; i++) {
-        identity_map_page(framebuffer_address);
-        framebuffer_address += PAGE_SIZE;
-    }
-    term_write("mapped all of the uefi memory map\n");
-
+    uint64_t framebuffer_size = (uint64_t) loader_data->framebuffer_pixels_per_line * loader_data->framebuffer_height * 4;
+    paging_identityMap(pml4_table, framebuffer_address, framebuffer_address + framebuffer_size, MEMORY_CACHE_WRITE_COMBINING);
+    timeline_phase("page tables");
+    term_write("mapped ram, the kernel & the framebuffer\n");
+
+    paging_stats* map_stats = paging_getStats();
+    kprintf("page tables: 1 pml4, %lu pdp, %lu pd, %lu pt\npages: %lu 1GiB, %lu 2MiB, %lu 4KiB\n",
+        map_stats->pdp_tables, map_stats->pd_tables, map_stats->page_tables,
+        map_stats->pages_1g, map_stats->pages_2m, map_stats->pages_4k);
+
+    timeline_phase("page table stats");
+    interrupts_setHandler(INTERRUPT_PAGE_FAULT, page_fault);
     load_page_map_level_4(pml4_table);
+    phys_offset = PHYS_DIRECT_MAP;
+    vm_init();
+    timeline_phase("cr3 load");
     term_write("loaded new page map\n");
+
+    // now that the firmware's page tables aren't in use, boot services memory can be reclaimed.
+    // we are still running on the firmware's stack though, so the region containing it has to wait
+    uint64_t stack_pointer;
+    asm("mov %%rsp, %0" : "=r"(stack_pointer));
+    for (uint64_t i = 0; i < loader_data->memory_map_size; i += loader_data->memory_descriptor_size) {
+        uefi_memory_descriptor* desc = (uefi_memory_descriptor*) &memory_map[i];
+        uint64_t end = desc->physical_start + (desc->page_count * PAGE_SIZE);
+        int holds_stack = stack_pointer >= desc->physical_start && stack_pointer < end;
+        if((desc->type == EfiBootServicesCode || desc->type == EfiBootServicesData) && !holds_stack) {
+            frame_addRegion(desc->physical_start, desc->page_count);
+        } else if(is_usable_memory(desc->type) && desc->type != EfiConventionalMemory) {
+            // loader data holds the memory map itself (and loader_data is on the stack)
+            defer_region(desc->physical_start, desc->page_count);
+        }
+    }
+
+    timeline_phase("reclaim boot services");
+
+    kprintf("free memory: %lu MiB, %d regions of loader memory & stack freed once boot is done\n",
+        frame_freeCount() / (1024 * 1024 / PAGE_SIZE), deferred_region_count);
+}
+
+uint64_t memory_reclaimLoaderMemory() {
+    uint64_t pages = 0;
+    spinlock_acquire(&memory_lock);
+    for(int i = 0; i < deferred_region_count; i++) {
+        frame_addRegion(deferred_regions[i].address, deferred_regions[i].page_count);
+        pages += deferred_regions[i].page_count;
+    }
+    deferred_region_count = 0;
+    spinlock_release(&memory_lock);
+    return pages;
+}
+
+#define CACHE_BATCH (MEMORY_FRAME_CACHE_SIZE / 2)
+
+// debug builds mark every frame while it's in a cache, so a second free of one is caught instead of handing it out twice.
+// the marks are in the allocator's shared state bytes, so release builds leave them out of the per-cpu path
+static inline int cache_mark(uint64_t frame) {
+#ifdef DEBUG
+    return frame_markCached(frame);
+#else
+    (void) frame;
+    return 1;
+#endif
+}
+
+static inline void cache_unmark(uint64_t frame) {
+#ifdef DEBUG
+    frame_unmarkCached(frame);
+#else
+    (void) frame;
+#endif
+}
+
+// the cache belongs to this cpu, so only an interrupt handler on this cpu could touch it at the same time
+static void* cache_allocate() {
+    uint64_t flags = cpu_disableInterrupts();
+    memory_frame_cache* cache = &cpu_current()->frame_cache;
+    if(cache->count == 0) {
+        cache->allocate_misses++;
+        spinlock_acquire(&memory_lock);
+        while(cache->count < CACHE_BATCH) {
+            uint64_t frame = frame_allocate(0);
+            if(!frame) break;
+            cache_mark(frame);
+            cache->frames[cache->count++] = frame;
+        }
+        spinlock_release(&memory_lock);
+    } else {
+        cache->allocate_hits++;
+    }
+    void* page = 0;
+    if(cache->count) {
+        uint64_t frame = cache->frames[--cache->count];
+        cache_unmark(frame);
+        page = phys_to_virt(frame);
+    }
+    cpu_restoreInterrupts(flags);
+    return page;
+}
+
+// returns 0 if the frame is already in a cache (only caught in debug builds)
+static int cache_free(uint64_t frame) {
+    if(!cache_mark(frame)) {
+        klog(KLOG_WARN, "memory: page %p freed twice", phys_to_virt(frame));
+        return 0;
+    }
+    uint64_t flags = cpu_disableInterrupts();
+    memory_frame_cache* cache = &cpu_current()->frame_cache;
+    if(cache->count == MEMORY_FRAME_CACHE_SIZE) {
+        cache->free_misses++;
+        spinlock_acquire(&memory_lock);
+        while(cache->count > MEMORY_FRAME_CACHE_SIZE - CACHE_BATCH) {
+            uint64_t cached = cache->frames[--cache->count];
+            cache_unmark(cached);
+            frame_free(cached);
+        }
+        spinlock_release(&memory_lock);
+    } else {
+        cache->free_hits++;
+    }
+    cache->frames[cache->count++] = frame;
+    cpu_restoreInterrupts(flags);
+    return 1;
 }
 
 void* memory_allocatePage() {
-    uint64_t page = get_next_page();
-    identity_map_page(page);
-    return (void*) page;
+    return cache_allocate();
+}
+
+void* memory_allocatePages(uint64_t count) {
+    if(count <= 1) return cache_allocate();
+    spinlock_acquire(&memory_lock);
+    uint64_t frame = frame_allocate(frame_orderFor(count));
+    spinlock_release(&memory_lock);
+    return frame ? phys_to_virt(frame) : 0;
+}
+
+uint64_t memory_freePages(void* pages) {
+    // cached frames still look allocated to the frame allocator, so single pages can go back to the cache
+    uint64_t frame = virt_to_phys(pages);
+    if(frame_orderOf(frame) == 0) return cache_free(frame);
+    spinlock_acquire(&memory_lock);
+    uint64_t count = frame_free(frame);
+    spinlock_release(&memory_lock);
+    return count;
+}
+
+void memory_printCacheStats() {
+    for(int i = 0; i < percpu_count(); i++) {
+        memory_frame_cache* cache = &percpu_get(i)->frame_cache;
+        kprintf("  cpu %d: allocate %lu hits/%lu misses, free %lu hits/%lu misses, %u cached\n", i,
+            cache->allocate_hits, cache->allocate_misses, cache->free_hits, cache->free_misses, cache->count);
+    }
 }
@@ -15,9 +15,66 @@
 
 #include <stdint.h>
 
+#include "spinlock.h"
 #include "uefi_loader.h"
 
+// values are the page attribute table index memory_init sets up for each type
+typedef enum {
+    MEMORY_CACHE_WRITE_BACK = 0,
+    MEMORY_CACHE_WRITE_COMBINING = 1,
+    MEMORY_CACHE_UNCACHED_MINUS = 2,    // UC, but MTRRs can make it WC
+    MEMORY_CACHE_UNCACHED = 3,
+    MEMORY_CACHE_WRITE_PROTECT = 5,
+    MEMORY_CACHE_WRITE_THROUGH = 7
+} memory_cache_type;
+
+// single pages are allocated from a per-cpu cache first, which refills/drains half of itself at a time from the global allocator
+#define MEMORY_FRAME_CACHE_SIZE 64
+
+typedef struct {
+    uint32_t count;
+    uint64_t allocate_hits;
+    uint64_t allocate_misses;   // had to refill from the global allocator
+    uint64_t free_hits;
+    uint64_t free_misses;       // had to drain to the global allocator
+    uint64_t frames[MEMORY_FRAME_CACHE_SIZE];
+} memory_frame_cache;
+
+// how many pages below 1 MiB memory_init sets aside, see memory_lowMemory
+#define MEMORY_LOW_PAGES 2
+
 void memory_init(loader_data* loader_data);
+// sets up the per-cpu parts of memory management (the PAT) on another cpu
+void memory_initCpu();
+// frees the loader's memory & stack. only call this once running on a kernel stack and done with loader_data.
+// returns how many pages were freed
+uint64_t memory_reclaimLoaderMemory();
+
+// all of these are O(1). blocks from memory_allocatePages are rounded up to a power of two pages.
+// single pages usually come from this cpu's cache without taking any lock.
+// the pointers are in the direct map, virt_to_phys gives the physical address
 void* memory_allocatePage();
+void* memory_allocatePages(uint64_t count);
+// returns how many pages were freed
+uint64_t memory_freePages(void* pages);
+// hit & miss counts of every cpu's page cache
+void memory_printCacheStats();
+
+// guards the frame allocator & every page map (changing a page map can allocate tables). any cpu can allocate
+extern spinlock memory_lock;
+
+// the kernel's top level page table, which is identity mapped like everything else
+uint64_t* memory_pageMap();
+// physical address of MEMORY_LOW_PAGES free pages below 1 MiB (for real mode code), or 0 if there weren't any
+uint64_t memory_lowMemory();
+
+// identity maps a range of physical memory that memory_init left unmapped (device registers, firmware tables in reserved memory)
+void memory_mapMMIO(uint64_t address, uint64_t size, memory_cache_type cache_type);
+
+// reserves size bytes of address space. nothing is allocated until a page is first touched, then the page fault
+// handler backs it with a zeroed frame. returns 0 if there are no reservation slots left
+void* memory_reserve(uint64_t size, memory_cache_type cache_type);
+// pages given to reservations so far
+uint64_t memory_committedPages();
 
 #endif
\ No newline at end of file
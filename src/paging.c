@@ -0,0 +1,255 @@
+/* paging.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "mem.h"
+#include "phys.h"
+#include "term.h"
+#include "frame_allocator.h"
+#include "paging.h"
+
+static uint64_t allocate_table() {
+    uint64_t table = frame_allocate(0);
+    if(!table) {
+        term_write("out of memory for page tables!\n");
+        term_flush();
+        while(1);
+    }
+    memzero(phys_to_virt(table), PAGE_SIZE);
+    return table;
+}
+
+static int has_2m_pages;
+static int has_1g_pages;
+static int has_pat;
+
+static paging_stats map_stats;
+
+// page attribute table index bits, in a page table entry and in a 1 GiB/2 MiB entry (where bit 7 is PAGE_LARGE)
+static uint64_t cache_bits(memory_cache_type type, int large) {
+    uint64_t pat_index = has_pat ? type : (type & 3); // without a PAT only the PWT & PCD bits mean anything
+    uint64_t bits = 0;
+    if(pat_index & 1) bits |= PAGE_WRITE_THROUGH;
+    if(pat_index & 2) bits |= PAGE_CACHE_DISABLE;
+    if(pat_index & 4) bits |= large ? PAGE_LARGE_PAT : PAGE_PAT;
+    return bits;
+}
+
+// replaces a 1 GiB/2 MiB page with a table of 512 pages of the next size down that map the same memory the same way
+static void split_large_page(uint64_t* entry, uint64_t large_size, uint64_t* table_count) {
+    uint64_t table = allocate_table();
+    uint64_t* children = phys_to_virt(table);
+    uint64_t base = *entry & PAGE_ADDRESS_MASK & ~(large_size - 1);
+    uint64_t attributes = *entry & ~PAGE_ADDRESS_MASK & ~PAGE_LARGE_PAT;
+    uint64_t child_size = large_size / PAGE_TABLE_ENTRY_COUNT;
+    int pat = (*entry & PAGE_LARGE_PAT) != 0;
+
+    if(child_size == PAGE_SIZE) { // bit 7 is the PAT bit in a page table entry
+        attributes = (attributes & ~PAGE_LARGE) | (pat ? PAGE_PAT : 0);
+    } else {
+        attributes |= pat ? PAGE_LARGE_PAT : 0;
+    }
+    for(int i = 0; i < PAGE_TABLE_ENTRY_COUNT; i++) {
+        children[i] = (base + i * child_size) | attributes;
+    }
+    *entry = table | PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER;
+    (*table_count)++;
+    if(large_size == PAGE_SIZE_1G) {
+        map_stats.pages_1g--;
+        map_stats.pages_2m += PAGE_TABLE_ENTRY_COUNT;
+    } else {
+        map_stats.pages_2m--;
+        map_stats.pages_4k += PAGE_TABLE_ENTRY_COUNT;
+    }
+}
+
+// returns the table an entry points to, allocating it first if the entry is empty or splitting it if it's a large page
+static uint64_t* next_table(uint64_t* entry, uint64_t large_size, uint64_t* table_count) {
+    if(!(*entry & PAGE_PRESENT)) {
+        *entry = allocate_table() | PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER;
+        (*table_count)++;
+    } else if(*entry & PAGE_LARGE) {
+        split_large_page(entry, large_size, table_count);
+    }
+    return phys_to_virt(*entry & PAGE_ADDRESS_MASK);
+}
+
+// whether a large page entry can be (re)written to map virtual to physical, instead of going down to a table
+static inline int can_map_large(uint64_t entry, uint64_t virtual, uint64_t physical, uint64_t end, uint64_t large_size) {
+    return ((virtual | physical) & (large_size - 1)) == 0 && end - virtual >= large_size
+        && (!(entry & PAGE_PRESENT) || (entry & PAGE_LARGE));
+}
+
+// whether a large page entry already maps virtual to physical the way we want (ignoring the accessed & dirty bits the cpu sets)
+static inline int already_mapped(uint64_t entry, uint64_t virtual, uint64_t physical, uint64_t large_size, uint64_t flags) {
+    return (entry & PAGE_LARGE) && ((virtual ^ physical) & (large_size - 1)) == 0
+        && (entry & ~(PAGE_ACCESSED | PAGE_DIRTY)) == ((physical & ~(large_size - 1)) | flags);
+}
+
+// page tables are allocated from memory that is already mapped, so they don't need mapping themselves
+void paging_map(uint64_t* pml4, uint64_t virtual, uint64_t physical, uint64_t size, uint64_t flags, memory_cache_type cache_type) {
+    flags = (flags & PAGE_PROTECTION_FLAGS) | PAGE_PRESENT;
+    uint64_t large_flags = flags | PAGE_LARGE | cache_bits(cache_type, 1);
+    uint64_t small_flags = flags | cache_bits(cache_type, 0);
+    uint64_t end = virtual + size;
+
+    while(virtual < end) {
+        uint64_t pml4_index = (virtual >> 39) & 0x1ff;
+        uint64_t pdp_index = (virtual >> 30) & 0x1ff;
+        uint64_t pd_index = (virtual >> 21) & 0x1ff;
+        uint64_t pt_index = (virtual >> 12) & 0x1ff;
+
+        uint64_t* pdp_table = next_table(&pml4[pml4_index], 0, &map_stats.pdp_tables);
+
+        uint64_t* pdp_entry = &pdp_table[pdp_index];
+        if(already_mapped(*pdp_entry, virtual, physical, PAGE_SIZE_1G, large_flags)) {
+            uint64_t step = PAGE_SIZE_1G - (virtual & (PAGE_SIZE_1G - 1));
+            virtual += step;
+            physical += step;
+            continue;
+        }
+        if(has_1g_pages && can_map_large(*pdp_entry, virtual, physical, end, PAGE_SIZE_1G)) {
+            if(!(*pdp_entry & PAGE_PRESENT)) map_stats.pages_1g++;
+            *pdp_entry = physical | large_flags;
+            virtual += PAGE_SIZE_1G;
+            physical += PAGE_SIZE_1G;
+            continue;
+        }
+        uint64_t* pd_table = next_table(pdp_entry, PAGE_SIZE_1G, &map_stats.pd_tables);
+
+        uint64_t* pd_entry = &pd_table[pd_index];
+        if(already_mapped(*pd_entry, virtual, physical, PAGE_SIZE_2M, large_flags)) {
+            uint64_t step = PAGE_SIZE_2M - (virtual & (PAGE_SIZE_2M - 1));
+            virtual += step;
+            physical += step;
+            continue;
+        }
+        if(has_2m_pages && can_map_large(*pd_entry, virtual, physical, end, PAGE_SIZE_2M)) {
+            if(!(*pd_entry & PAGE_PRESENT)) map_stats.pages_2m++;
+            *pd_entry = physical | large_flags;
+            virtual += PAGE_SIZE_2M;
+            physical += PAGE_SIZE_2M;
+            continue;
+        }
+        uint64_t* page_table = next_table(pd_entry, PAGE_SIZE_2M, &map_stats.page_tables);
+
+        // only the edges of a range get here, fill the rest of this page table in one go
+        for(; pt_index < PAGE_TABLE_ENTRY_COUNT && virtual < end; pt_index++) {
+            if(!(page_table[pt_index] & PAGE_PRESENT)) map_stats.pages_4k++;
+            page_table[pt_index] = physical | small_flags;
+            virtual += PAGE_SIZE;
+            physical += PAGE_SIZE;
+        }
+    }
+}
+
+void paging_identityMap(uint64_t* pml4, uint64_t begin, uint64_t end, memory_cache_type cache_type) {
+    begin &= ~(uint64_t)(PAGE_SIZE - 1);
+    end = (end + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1);
+    if(begin < end) paging_map(pml4, begin, begin, end - begin, PAGE_WRITABLE | PAGE_USER, cache_type);
+}
+
+// the leaf entry mapping virtual, or 0 if nothing is mapped there. *size is set to how much address space the entry
+// (or the hole) covers from virtual on. large pages that stick out of [virtual, end) are split first
+static uint64_t* leaf_entry(uint64_t* pml4, uint64_t virtual, uint64_t end, uint64_t* size) {
+    uint64_t* entry = &pml4[(virtual >> 39) & 0x1ff];
+    if(!(*entry & PAGE_PRESENT)) {
+        *size = (1ull << 39) - (virtual & ((1ull << 39) - 1));
+        return 0;
+    }
+
+    uint64_t* pdp_table = phys_to_virt(*entry & PAGE_ADDRESS_MASK);
+    entry = &pdp_table[(virtual >> 30) & 0x1ff];
+    *size = PAGE_SIZE_1G - (virtual & (PAGE_SIZE_1G - 1));
+    if(!(*entry & PAGE_PRESENT)) return 0;
+    if(*entry & PAGE_LARGE) {
+        if(*size == PAGE_SIZE_1G && end - virtual >= PAGE_SIZE_1G) return entry;
+        split_large_page(entry, PAGE_SIZE_1G, &map_stats.pd_tables);
+    }
+
+    uint64_t* pd_table = phys_to_virt(*entry & PAGE_ADDRESS_MASK);
+    entry = &pd_table[(virtual >> 21) & 0x1ff];
+    *size = PAGE_SIZE_2M - (virtual & (PAGE_SIZE_2M - 1));
+    if(!(*entry & PAGE_PRESENT)) return 0;
+    if(*entry & PAGE_LARGE) {
+        if(*size == PAGE_SIZE_2M && end - virtual >= PAGE_SIZE_2M) return entry;
+        split_large_page(entry, PAGE_SIZE_2M, &map_stats.page_tables);
+    }
+
+    uint64_t* page_table = phys_to_virt(*entry & PAGE_ADDRESS_MASK);
+    entry = &page_table[(virtual >> 12) & 0x1ff];
+    *size = PAGE_SIZE;
+    return (*entry & PAGE_PRESENT) ? entry : 0;
+}
+
+uint64_t paging_unmap(uint64_t* pml4, uint64_t virtual, uint64_t size) {
+    uint64_t end = virtual + size;
+    uint64_t pages = 0;
+    while(virtual < end) {
+        uint64_t entry_size;
+        uint64_t* entry = leaf_entry(pml4, virtual, end, &entry_size);
+        if(entry) {
+            *entry = 0;
+            pages += entry_size / PAGE_SIZE;
+            if(entry_size == PAGE_SIZE_1G) map_stats.pages_1g--;
+            else if(entry_size == PAGE_SIZE_2M) map_stats.pages_2m--;
+            else map_stats.pages_4k--;
+        }
+        virtual += entry_size;
+    }
+    return pages;
+}
+
+uint64_t paging_protect(uint64_t* pml4, uint64_t virtual, uint64_t size, uint64_t flags) {
+    uint64_t end = virtual + size;
+    uint64_t pages = 0;
+    flags &= PAGE_PROTECTION_FLAGS;
+    while(virtual < end) {
+        uint64_t entry_size;
+        uint64_t* entry = leaf_entry(pml4, virtual, end, &entry_size);
+        if(entry) {
+            *entry = (*entry & ~(uint64_t) PAGE_PROTECTION_FLAGS) | flags;
+            pages += entry_size / PAGE_SIZE;
+        }
+        virtual += entry_size;
+    }
+    return pages;
+}
+
+uint64_t paging_translate(uint64_t* pml4, uint64_t virtual) {
+    uint64_t entry = pml4[(virtual >> 39) & 0x1ff];
+    if(!(entry & PAGE_PRESENT)) return PAGING_NOT_MAPPED;
+
+    entry = ((uint64_t*) phys_to_virt(entry & PAGE_ADDRESS_MASK))[(virtual >> 30) & 0x1ff];
+    if(!(entry & PAGE_PRESENT)) return PAGING_NOT_MAPPED;
+    if(entry & PAGE_LARGE) return (entry & PAGE_ADDRESS_MASK & ~(PAGE_SIZE_1G - 1)) | (virtual & (PAGE_SIZE_1G - 1));
+
+    entry = ((uint64_t*) phys_to_virt(entry & PAGE_ADDRESS_MASK))[(virtual >> 21) & 0x1ff];
+    if(!(entry & PAGE_PRESENT)) return PAGING_NOT_MAPPED;
+    if(entry & PAGE_LARGE) return (entry & PAGE_ADDRESS_MASK & ~(PAGE_SIZE_2M - 1)) | (virtual & (PAGE_SIZE_2M - 1));
+
+    entry = ((uint64_t*) phys_to_virt(entry & PAGE_ADDRESS_MASK))[(virtual >> 12) & 0x1ff];
+    if(!(entry & PAGE_PRESENT)) return PAGING_NOT_MAPPED;
+    return (entry & PAGE_ADDRESS_MASK) | (virtual & (PAGE_SIZE - 1));
+}
+
+void paging_init(int has_2m, int has_1g, int pat) {
+    has_2m_pages = has_2m;
+    has_1g_pages = has_1g;
+    has_pat = pat;
+    map_stats = (paging_stats) { 0 };
+}
+
+paging_stats* paging_getStats() {
+    return &map_stats;
+}
@@ -0,0 +1,75 @@
+/* paging.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  builds 4-level page tables. tables come from the frame allocator and are reached through phys_to_virt.
+  doesn't lock or flush anything, that's up to the caller
+ */
+
+#ifndef PAGING_H
+#define PAGING_H
+
+#include <stdint.h>
+
+#include "memory_manager.h"
+
+#define PAGE_SIZE 4096
+
+#define PAGE_TABLE_ENTRY_COUNT 512
+// page-aligned 52-bit address
+#define PAGE_ADDRESS_MASK 0x000ffffffffff000
+
+#define PAGE_PRESENT    (1<<0)
+#define PAGE_WRITABLE   (1<<1)
+#define PAGE_USER       (1<<2)
+#define PAGE_WRITE_THROUGH (1<<3)   // PAT index bit 0
+#define PAGE_CACHE_DISABLE (1<<4)   // PAT index bit 1
+#define PAGE_ACCESSED   (1<<5)
+#define PAGE_DIRTY      (1<<6)
+#define PAGE_PAT        (1<<7)  // PAT index bit 2, in a page table entry
+#define PAGE_LARGE      (1<<7)  // in a pdp/pd entry: maps a 1 GiB/2 MiB page instead of pointing to a table
+#define PAGE_LARGE_PAT  (1<<12) // PAT index bit 2, in a 1 GiB/2 MiB page entry
+#define PAGE_NO_EXECUTE (1ull<<63)
+
+// the flags that paging_map & paging_protect take, the rest of an entry is the address & cache type
+#define PAGE_PROTECTION_FLAGS (PAGE_WRITABLE | PAGE_USER | PAGE_NO_EXECUTE)
+
+#define PAGE_SIZE_2M (1ull << 21)
+#define PAGE_SIZE_1G (1ull << 30)
+
+// how many of each table & page size the page maps use
+typedef struct {
+    uint64_t pdp_tables;
+    uint64_t pd_tables;
+    uint64_t page_tables;
+    uint64_t pages_1g;
+    uint64_t pages_2m;
+    uint64_t pages_4k;
+} paging_stats;
+
+// which page sizes can be used, and whether the PAT is set up (see memory_cache_type). also resets the stats
+void paging_init(int has_2m_pages, int has_1g_pages, int has_pat);
+// maps size bytes at virtual to physical (both page aligned), using the largest pages the alignment of both allows.
+// anything already mapped there is replaced. flags are PAGE_PROTECTION_FLAGS
+void paging_map(uint64_t* pml4, uint64_t virtual, uint64_t physical, uint64_t size, uint64_t flags, memory_cache_type cache_type);
+// maps [begin, end) to itself, rounded out to whole pages
+void paging_identityMap(uint64_t* pml4, uint64_t begin, uint64_t end, memory_cache_type cache_type);
+
+#define PAGING_NOT_MAPPED ((uint64_t) -1)
+// the physical address virtual maps to, or PAGING_NOT_MAPPED
+uint64_t paging_translate(uint64_t* pml4, uint64_t virtual);
+// unmaps [virtual, virtual + size), splitting large pages that are only partly inside it. the frames & emptied tables are kept.
+// returns how many pages were mapped there
+uint64_t paging_unmap(uint64_t* pml4, uint64_t virtual, uint64_t size);
+// replaces the PAGE_PROTECTION_FLAGS of whatever is mapped in [virtual, virtual + size). returns how many pages that was
+uint64_t paging_protect(uint64_t* pml4, uint64_t virtual, uint64_t size, uint64_t flags);
+paging_stats* paging_getStats();
+
+#endif
@@ -0,0 +1,126 @@
+/* percpu.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "mem.h"
+#include "apic.h"
+#include "memory_manager.h"
+#include "percpu.h"
+
+#define MSR_GS_BASE 0xC0000101
+
+// --- Global Descriptor Table ---
+// every cpu gets a copy of this, with the TSS descriptor pointing at its own TSS
+static const struct gdt_table gdt_template = {
+//            type  flags
+    {0, 0, 0,    0,    0, 0},  /* 0x00 null  */
+    {0, 0, 0, 0x9A, 0xA0, 0},  /* 0x08 kernel code (kernel base selector) */
+    {0, 0, 0, 0x92, 0xA0, 0},  /* 0x10 kernel data */
+    {0, 0, 0,    0,    0, 0},  /* 0x18 null (user base selector) */
+    {0, 0, 0, 0x92, 0xA0, 0},  /* 0x20 user data */
+    {0, 0, 0, 0x9A, 0xA0, 0},  /* 0x28 user code */
+    {0, 0, 0, 0x92, 0xA0, 0},  /* 0x30 ovmf data */
+    {0, 0, 0, 0x9A, 0xA0, 0},  /* 0x38 ovmf code */
+    {0, 0, 0, 0x89, 0xA0, 0},  /* 0x40 tss low */
+    {0, 0, 0,    0,    0, 0},  /* 0x48 tss high */
+// type  0x9A = 1001_1010 = present,  privilege level 0,  user (for code)    ; code, not conforming, [readable, not accessed]
+// type  0x92 = 1001_0010 = present, [privilege level 0], user (for data)    ; data, [not expand down, writable, not accessed]
+// type  0x89 = 1000_1001 = present,  privilege level 0, system (for TSS)    ; available 64-bit TSS
+// flags 0xA0 = 1010_0000 = [granularity = 4KiB], long mode (D0, L1), unused ; [segment limit = 0]
+//                          "long mode" bits ignored by data & TSS segments
+// brackets indicate bits that are ignored in long mode
+};
+
+#pragma pack (1)
+struct table_ptr {
+    uint16_t limit;
+    uint64_t base;
+};
+#pragma pack ()
+
+extern void load_gdt(struct table_ptr* gdt_ptr);
+
+static cpu_data bsp_data;
+static cpu_data* cpus[APIC_MAX_CPUS];
+static int cpu_count;
+
+static void setup_gdt(cpu_data* cpu) {
+    memzero(&cpu->tss, sizeof(cpu->tss));
+    cpu->tss.rsp0 = cpu->stack_top;
+
+    cpu->gdt = gdt_template;
+    uint64_t tss_base = (uint64_t) &cpu->tss;
+    cpu->gdt.tss_low.base15_0 = tss_base & 0xffff;
+    cpu->gdt.tss_low.base23_16 = (tss_base >> 16) & 0xff;
+    cpu->gdt.tss_low.base31_24 = (tss_base >> 24) & 0xff;
+    cpu->gdt.tss_low.limit15_0 = sizeof(cpu->tss);
+    // base 32-63
+    cpu->gdt.tss_high.limit15_0 = (tss_base >> 32) & 0xffff;
+    cpu->gdt.tss_high.base15_0 = (tss_base >> 48) & 0xffff;
+}
+
+void percpu_load(cpu_data* cpu) {
+    struct table_ptr gdt_ptr = { sizeof(cpu->gdt)-1, (uint64_t)&cpu->gdt };
+    load_gdt(&gdt_ptr);
+    // loading a selector into gs clears its base, so this has to come after
+    cpu_writeMsr(MSR_GS_BASE, (uint64_t) cpu);
+}
+
+static void init_data(cpu_data* cpu, uint32_t index, uint32_t apic_id, uint64_t stack_top) {
+    memzero(cpu, sizeof(cpu_data));
+    cpu->self = cpu;
+    cpu->index = index;
+    cpu->apic_id = apic_id;
+    cpu->stack_top = stack_top;
+    cpu->steal_seed = 0x9E3779B97F4A7C15ull * (index + 1); // anything non-zero, and different per cpu
+    setup_gdt(cpu);
+    task_initQueue(&cpu->tasks, index);
+}
+
+void percpu_initBsp() {
+    // the apic isn't set up yet, smp_init fills in the id
+    init_data(&bsp_data, 0, 0, 0);
+    percpu_load(&bsp_data);
+    bsp_data.online = 1;
+    cpus[0] = &bsp_data;
+    cpu_count = 1;
+}
+
+cpu_data* percpu_create(uint32_t apic_id) {
+    if(cpu_count >= APIC_MAX_CPUS) return 0;
+    cpu_data* cpu = memory_allocatePages((sizeof(cpu_data) + 4095) / 4096);
+    uint8_t* stack = memory_allocatePages(PERCPU_STACK_PAGES);
+    if(!cpu || !stack) {
+        if(cpu) memory_freePages(cpu);
+        if(stack) memory_freePages(stack);
+        return 0;
+    }
+    // cpus only come online one at a time, so the next free slot is this cpu's
+    init_data(cpu, cpu_count, apic_id, (uint64_t) stack + PERCPU_STACK_PAGES * 4096);
+    return cpu;
+}
+
+void percpu_register(cpu_data* cpu) {
+    cpus[cpu->index] = cpu;
+    // other cpus look at the list while stealing, the entry must be there before the count includes it
+    __atomic_store_n(&cpu_count, cpu->index + 1, __ATOMIC_RELEASE);
+}
+
+int percpu_count() {
+    return __atomic_load_n(&cpu_count, __ATOMIC_ACQUIRE);
+}
+
+cpu_data* percpu_get(int index) {
+    return cpus[index];
+}
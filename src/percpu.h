@@ -0,0 +1,90 @@
+/* percpu.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  data that every cpu has its own copy of: GDT, TSS, kernel stack, scheduler deque and task queue.
+  the GS base of each cpu points at its cpu_data
+ */
+
+#ifndef PERCPU_H
+#define PERCPU_H
+
+#include <stdint.h>
+
+#include "sched.h"
+#include "task.h"
+#include "memory_manager.h"
+
+#define PERCPU_STACK_PAGES 4
+
+#pragma pack (1)
+struct gdt_entry {
+  uint16_t limit15_0;            uint16_t base15_0;
+  uint8_t  base23_16;            uint8_t  type;
+  uint8_t  limit19_16_and_flags; uint8_t  base31_24;
+};
+
+struct tss {
+    uint32_t reserved0; uint64_t rsp0;      uint64_t rsp1;
+    uint64_t rsp2;      uint64_t reserved1; uint64_t ist1;
+    uint64_t ist2;      uint64_t ist3;      uint64_t ist4;
+    uint64_t ist5;      uint64_t ist6;      uint64_t ist7;
+    uint64_t reserved2; uint16_t reserved3; uint16_t iopb_offset;
+};
+
+struct gdt_table {
+  struct gdt_entry null;
+  struct gdt_entry kernel_code;
+  struct gdt_entry kernel_data;
+  struct gdt_entry null2;
+  struct gdt_entry user_data;
+  struct gdt_entry user_code;
+  struct gdt_entry ovmf_data;
+  struct gdt_entry ovmf_code;
+  struct gdt_entry tss_low;
+  struct gdt_entry tss_high;
+};
+#pragma pack ()
+
+typedef struct cpu_data {
+    struct cpu_data* self;      // at %gs:0, so finding this is one load
+    uint32_t index;             // position in the cpu list, the bootstrap processor is 0
+    uint32_t apic_id;
+    uint64_t stack_top;         // 0 for the bootstrap processor, which is still on the firmware's stack
+    volatile uint32_t online;   // set by the cpu itself once it's running kernel code
+    uint64_t steal_seed;        // for picking which cpu to steal from
+    uint64_t tasks_run;
+    uint64_t tasks_stolen;
+    __attribute__((aligned(16))) struct gdt_table gdt;
+    struct tss tss;
+    __attribute__((aligned(64))) memory_frame_cache frame_cache;
+    __attribute__((aligned(64))) sched_deque deque;
+    __attribute__((aligned(64))) task_queue tasks;
+} cpu_data;
+
+static inline cpu_data* cpu_current() {
+    cpu_data* cpu;
+    asm volatile("mov %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+// loads the bootstrap processor's GDT/TSS and GS base, this has to happen before anything uses cpu_current()
+void percpu_initBsp();
+// allocates the data & kernel stack for another cpu. returns 0 if out of memory
+cpu_data* percpu_create(uint32_t apic_id);
+// loads a cpu's GDT/TSS and GS base, on that cpu
+void percpu_load(cpu_data* cpu);
+// adds a cpu that came online to the cpu list
+void percpu_register(cpu_data* cpu);
+
+int percpu_count();
+cpu_data* percpu_get(int index);
+
+#endif
@@ -0,0 +1,49 @@
+/* phys.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  converting between physical addresses and pointers the kernel can use.
+  code that touches physical memory it didn't get as a pointer (page tables, free frames) goes through these,
+  so it can also run on the host (see bench/) against fake physical memory
+ */
+
+#ifndef PHYS_H
+#define PHYS_H
+
+#include <stdint.h>
+
+#ifdef PHYS_HOSTED
+// the host program points this at a big reservation that stands in for physical memory
+extern uint8_t* phys_base;
+
+static inline void* phys_to_virt(uint64_t physical) {
+    return phys_base + physical;
+}
+static inline uint64_t virt_to_phys(void* pointer) {
+    return (uint8_t*) pointer - phys_base;
+}
+#else
+// all of ram is mapped here (the first pml4 entry of the higher half), using the biggest pages that fit
+#define PHYS_DIRECT_MAP 0xffff800000000000
+
+// 0 while ram is only identity mapped, PHYS_DIRECT_MAP once memory_init has loaded the kernel's page map
+extern uint64_t phys_offset;
+
+static inline void* phys_to_virt(uint64_t physical) {
+    return (void*) (physical + phys_offset);
+}
+// ram is still identity mapped too (the kernel runs at its physical address), so this takes pointers from either mapping
+static inline uint64_t virt_to_phys(void* pointer) {
+    uint64_t address = (uint64_t) pointer;
+    return address >= PHYS_DIRECT_MAP ? address - PHYS_DIRECT_MAP : address;
+}
+#endif
+
+#endif
@@ -0,0 +1,148 @@
+/* sched.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "percpu.h"
+#include "klog.h"
+#include "term.h"
+#include "sched.h"
+
+#define DEQUE_MASK (SCHED_DEQUE_SIZE - 1)
+
+// the deque is the C11 version of Chase-Lev from "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al.).
+// top and bottom only ever grow, the slot is the index masked to the array size
+
+// owner only. returns 0 if the deque is full
+static int deque_push(sched_deque* deque, sched_task* task) {
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    if(bottom - top >= SCHED_DEQUE_SIZE) return 0;
+    __atomic_store_n(&deque->tasks[bottom & DEQUE_MASK], task, __ATOMIC_RELAXED);
+    // the task has to be visible before a thief can see the new bottom
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+// owner only, takes the newest task
+static sched_task* deque_pop(sched_deque* deque) {
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    // thieves must see the lowered bottom before we look at top, or both sides could take the last task
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if(top > bottom) { // it was empty
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    sched_task* task = __atomic_load_n(&deque->tasks[bottom & DEQUE_MASK], __ATOMIC_RELAXED);
+    if(top == bottom) { // the last task, race the thieves for it
+        if(!__atomic_compare_exchange_n(&deque->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            task = 0;
+        }
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+// any cpu, takes the oldest task. returns 0 if it's empty or another cpu got there first
+static sched_task* deque_steal(sched_deque* deque) {
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    if(top >= bottom) return 0;
+
+    sched_task* task = __atomic_load_n(&deque->tasks[top & DEQUE_MASK], __ATOMIC_RELAXED);
+    if(!__atomic_compare_exchange_n(&deque->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    return task;
+}
+
+static void run_task(cpu_data* cpu, sched_task* task) {
+    // the waiter may reuse the task as soon as the count drops, so don't touch it after that
+    sched_group* group = task->group;
+    task->function(task->argument);
+    cpu->tasks_run++;
+    __atomic_sub_fetch(&group->pending, 1, __ATOMIC_RELEASE);
+}
+
+static uint64_t next_random(cpu_data* cpu) {
+    // xorshift64
+    uint64_t x = cpu->steal_seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    cpu->steal_seed = x;
+    return x;
+}
+
+// this cpu's newest task, or else the oldest task of another cpu, starting from a random one
+static sched_task* find_task(cpu_data* cpu) {
+    sched_task* task = deque_pop(&cpu->deque);
+    if(task) return task;
+
+    int count = percpu_count();
+    if(count < 2) return 0;
+    int start = next_random(cpu) % count;
+    for(int i = 0; i < count; i++) {
+        cpu_data* victim = percpu_get((start + i) % count);
+        if(victim == cpu || !victim->online) continue;
+        task = deque_steal(&victim->deque);
+        if(task) {
+            cpu->tasks_stolen++;
+            return task;
+        }
+    }
+    return 0;
+}
+
+void sched_spawn(sched_group* group, sched_task* task) {
+    task->group = group;
+    __atomic_add_fetch(&group->pending, 1, __ATOMIC_RELAXED);
+    cpu_data* cpu = cpu_current();
+    if(!deque_push(&cpu->deque, task)) {
+        run_task(cpu, task);
+    }
+}
+
+void sched_wait(sched_group* group) {
+    cpu_data* cpu = cpu_current();
+    while(__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) > 0) {
+        sched_task* task = find_task(cpu);
+        if(task) {
+            run_task(cpu, task);
+        } else {
+            cpu_pause();
+        }
+    }
+}
+
+void sched_workerLoop() {
+    cpu_data* cpu = cpu_current();
+    term_setFlushOnWrite(0); // this cpu flushes the terminal whenever it's idle from now on
+    while(1) {
+        sched_task* task = find_task(cpu);
+        if(task) {
+            run_task(cpu, task);
+        } else {
+            // nothing to run, so this is a good time to render the log.
+            // otherwise back off a little, so idle cpus aren't all hammering the same deques
+            if(!klog_drain()) {
+                for(int i = 0; i < 64; i++) cpu_pause();
+            }
+        }
+    }
+}
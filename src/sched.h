@@ -0,0 +1,51 @@
+/* sched.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  work-stealing task scheduler. each cpu has a Chase-Lev deque: the owner pushes & pops
+  at the bottom without any locked instructions (except when taking the last task),
+  idle cpus steal from the top of someone else's deque.
+  tasks are run to completion, they can't block. the caller owns the task memory.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+// must be a power of two
+#define SCHED_DEQUE_SIZE 256
+
+typedef struct {
+    volatile int64_t pending;   // tasks spawned in this group that haven't finished yet
+} sched_group;
+
+typedef struct sched_task {
+    void (*function)(void* argument);
+    void* argument;
+    sched_group* group;
+} sched_task;
+
+typedef struct {
+    volatile int64_t top;       // thieves take from here
+    uint8_t padding0[56];       // the two ends are on separate cache lines so the owner and thieves don't share one
+    volatile int64_t bottom;    // the owner pushes & pops here
+    uint8_t padding1[56];
+    sched_task* volatile tasks[SCHED_DEQUE_SIZE];
+} sched_deque;
+
+// queue a task on this cpu. if its deque is full the task is run right away instead
+void sched_spawn(sched_group* group, sched_task* task);
+// runs tasks (this cpu's own, or stolen ones) until every task in the group is done
+void sched_wait(sched_group* group);
+// runs tasks forever, for cpus that have nothing else to do
+__attribute__((noreturn)) void sched_workerLoop();
+
+#endif
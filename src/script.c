@@ -0,0 +1,279 @@
+/* script.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "lualib.h"
+
+#include "term.h"
+#include "heap.h"
+#include "arena.h"
+#include "initrd.h"
+#include "clock.h"
+#include "kprintf.h"
+#include "frame_allocator.h"
+#include "memory_manager.h"
+#include "script.h"
+
+extern const char script_bootChunk[];
+extern const char script_bootChunkEnd[];
+
+static lua_State* boot_state;
+static arena* boot_arena;
+
+// an error outside of any pcall, there's nothing to go back to
+static int panic(lua_State* L) {
+    kprintf("lua panic: %s\n", lua_tostring(L, -1));
+    term_flush();
+    while(1) asm("cli; hlt");
+    return 0;
+}
+
+static int traceback(lua_State* L) {
+    luaL_traceback(L, L, lua_tostring(L, 1), 1);
+    return 1;
+}
+
+// --- term library ---
+
+// term.write(...), like io.write. every argument goes through tostring
+static int term_write_lua(lua_State* L) {
+    int count = lua_gettop(L);
+    for(int i = 1; i <= count; i++) {
+        size_t length;
+        const char* string = luaL_tolstring(L, i, &length);
+        term_writeBuffer(string, length);
+        lua_pop(L, 1);
+    }
+    return 0;
+}
+
+static int term_setTextColor_lua(lua_State* L) {
+    term_setTextColor(luaL_checkinteger(L, 1));
+    return 0;
+}
+
+static int term_setBackgroundColor_lua(lua_State* L) {
+    term_setBackgroundColor(luaL_checkinteger(L, 1));
+    return 0;
+}
+
+static int term_setCursorPos_lua(lua_State* L) {
+    term_setCursorPos(luaL_checkinteger(L, 1), luaL_checkinteger(L, 2));
+    return 0;
+}
+
+static int term_scroll_lua(lua_State* L) {
+    term_scroll(luaL_checkinteger(L, 1));
+    return 0;
+}
+
+static int term_flush_lua(lua_State* L) {
+    (void) L;
+    term_flush();
+    return 0;
+}
+
+static const luaL_Reg term_functions[] = {
+    { "write", term_write_lua },
+    { "setTextColor", term_setTextColor_lua },
+    { "setBackgroundColor", term_setBackgroundColor_lua },
+    { "setCursorPos", term_setCursorPos_lua },
+    { "scroll", term_scroll_lua },
+    { "flush", term_flush_lua },
+    { NULL, NULL }
+};
+
+static const struct {
+    char name[10];
+    int color;
+} term_colors[] = {
+    { "white", COLORS_WHITE }, { "orange", COLORS_ORANGE }, { "magenta", COLORS_MAGENTA },
+    { "lightBlue", COLORS_LIGHTBLUE }, { "yellow", COLORS_YELLOW }, { "lime", COLORS_LIME },
+    { "pink", COLORS_PINK }, { "gray", COLORS_GRAY }, { "lightGray", COLORS_LIGHTGRAY },
+    { "cyan", COLORS_CYAN }, { "purple", COLORS_PURPLE }, { "blue", COLORS_BLUE },
+    { "brown", COLORS_BROWN }, { "green", COLORS_GREEN }, { "red", COLORS_RED },
+    { "black", COLORS_BLACK }
+};
+
+static int open_term(lua_State* L) {
+    luaL_newlib(L, term_functions);
+    lua_createtable(L, 0, sizeof(term_colors) / sizeof(term_colors[0]));
+    for(uint64_t i = 0; i < sizeof(term_colors) / sizeof(term_colors[0]); i++) {
+        lua_pushinteger(L, term_colors[i].color);
+        lua_setfield(L, -2, term_colors[i].name);
+    }
+    lua_setfield(L, -2, "colors");
+    return 1;
+}
+
+// --- memory library ---
+
+static void set_integer(lua_State* L, const char* name, uint64_t value) {
+    lua_pushinteger(L, value);
+    lua_setfield(L, -2, name);
+}
+
+// memory.stats() returns a table of page counts, and heap & lua memory use in bytes
+static int memory_stats_lua(lua_State* L) {
+    heap_stats heap;
+    heap_getStats(&heap);
+    arena_stats lua;
+    arena_getStats(boot_arena, &lua);
+    lua_createtable(L, 0, 8);
+    set_integer(L, "freePages", frame_freeCount());
+    set_integer(L, "totalPages", frame_totalCount());
+    set_integer(L, "committedPages", memory_committedPages());
+    set_integer(L, "heapUsed", heap.used_bytes);
+    set_integer(L, "heapSlabs", heap.slab_bytes);
+    set_integer(L, "heapLargePages", heap.large_pages);
+    set_integer(L, "luaUsed", lua.used_bytes);
+    set_integer(L, "luaPeak", lua.peak_bytes);
+    return 1;
+}
+
+// memory.read8/16/32/64(address) & memory.write8/16/32/64(address, value) on raw addresses, the width is an upvalue.
+// nothing is checked, reading something that isn't mapped is a page fault like it would be from C
+static int memory_read_lua(lua_State* L) {
+    uint64_t address = luaL_checkinteger(L, 1);
+    switch(lua_tointeger(L, lua_upvalueindex(1))) {
+        case 1: lua_pushinteger(L, *(volatile uint8_t*) address); break;
+        case 2: lua_pushinteger(L, *(volatile uint16_t*) address); break;
+        case 4: lua_pushinteger(L, *(volatile uint32_t*) address); break;
+        default: lua_pushinteger(L, *(volatile uint64_t*) address); break;
+    }
+    return 1;
+}
+
+static int memory_write_lua(lua_State* L) {
+    uint64_t address = luaL_checkinteger(L, 1);
+    uint64_t value = luaL_checkinteger(L, 2);
+    switch(lua_tointeger(L, lua_upvalueindex(1))) {
+        case 1: *(volatile uint8_t*) address = value; break;
+        case 2: *(volatile uint16_t*) address = value; break;
+        case 4: *(volatile uint32_t*) address = value; break;
+        default: *(volatile uint64_t*) address = value; break;
+    }
+    return 0;
+}
+
+static int open_memory(lua_State* L) {
+    lua_createtable(L, 0, 9);
+    lua_pushcfunction(L, memory_stats_lua);
+    lua_setfield(L, -2, "stats");
+    static const char widths[4][3] = { "8", "16", "32", "64" };
+    char name[8];
+    for(int i = 0; i < 4; i++) {
+        lua_pushinteger(L, 1 << i);
+        lua_pushcclosure(L, memory_read_lua, 1);
+        ksnprintf(name, sizeof(name), "read%s", widths[i]);
+        lua_setfield(L, -2, name);
+        lua_pushinteger(L, 1 << i);
+        lua_pushcclosure(L, memory_write_lua, 1);
+        ksnprintf(name, sizeof(name), "write%s", widths[i]);
+        lua_setfield(L, -2, name);
+    }
+    return 1;
+}
+
+// --- initrd library ---
+
+// initrd.read(path) returns the file's contents as a string, or nil if there's no such file
+static int initrd_read_lua(lua_State* L) {
+    const initrd_file* file = initrd_find(luaL_checkstring(L, 1));
+    if(!file) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_pushlstring(L, (const char*) file->data, file->size);
+    return 1;
+}
+
+// initrd.load(path) loads a script (source or bytecode) from the initrd straight out of the archive, like loadfile.
+// returns the chunk as a function, or nil & an error message
+static int initrd_load_lua(lua_State* L) {
+    const char* path = luaL_checkstring(L, 1);
+    const initrd_file* file = initrd_find(path);
+    if(!file) {
+        lua_pushnil(L);
+        lua_pushfstring(L, "%s: not in the initrd", path);
+        return 2;
+    }
+    const char* chunk_name = lua_pushfstring(L, "@%s", path);
+    if(luaL_loadbufferx(L, (const char*) file->data, file->size, chunk_name, "bt") != LUA_OK) {
+        lua_pushnil(L);
+        lua_insert(L, -2);
+        return 2;
+    }
+    return 1;
+}
+
+static const luaL_Reg initrd_functions[] = {
+    { "read", initrd_read_lua },
+    { "load", initrd_load_lua },
+    { NULL, NULL }
+};
+
+static int open_initrd(lua_State* L) {
+    luaL_newlib(L, initrd_functions);
+    return 1;
+}
+
+// --- boot ---
+
+static const luaL_Reg libraries[] = {
+    { LUA_GNAME, luaopen_base },
+    { LUA_COLIBNAME, luaopen_coroutine },
+    { LUA_TABLIBNAME, luaopen_table },
+    { LUA_STRLIBNAME, luaopen_string },
+    { LUA_MATHLIBNAME, luaopen_math },
+    { LUA_UTF8LIBNAME, luaopen_utf8 },
+    { "term", open_term },
+    { "memory", open_memory },
+    { "initrd", open_initrd },
+    { NULL, NULL }
+};
+
+void script_runBoot() {
+    uint64_t start = cycles_now();
+    boot_arena = arena_create();
+    lua_State* L = boot_arena ? lua_newstate(arena_luaAlloc, boot_arena) : 0;
+    if(!L) {
+        term_write("lua: out of memory\n");
+        return;
+    }
+    lua_atpanic(L, panic);
+    for(const luaL_Reg* library = libraries; library->func; library++) {
+        luaL_requiref(L, library->name, library->func, 1);
+        lua_pop(L, 1);
+    }
+    boot_state = L;
+
+    uint64_t loaded = cycles_now();
+    lua_pushcfunction(L, traceback);
+    // "b" refuses source text, the chunk is always precompiled
+    int status = luaL_loadbufferx(L, script_bootChunk, script_bootChunkEnd - script_bootChunk, "=boot", "b");
+    uint64_t ran = cycles_now();
+    if(status == LUA_OK) {
+        status = lua_pcall(L, 0, 0, -2);
+    }
+    uint64_t end = cycles_now();
+    if(status != LUA_OK) {
+        kprintf("lua: %s\n", lua_tostring(L, -1));
+    }
+    lua_settop(L, 0);
+    kprintf("lua: state in %lu us, %lu bytes of bytecode loaded in %lu us, ran in %lu us\n",
+        time_cyclesToNs(loaded - start) / 1000, (uint64_t) (script_bootChunkEnd - script_bootChunk),
+        time_cyclesToNs(ran - loaded) / 1000, time_cyclesToNs(end - ran) / 1000);
+}
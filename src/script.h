@@ -0,0 +1,24 @@
+/* script.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  the lua VM. the boot scripts in lua/ are compiled by luac when the kernel is built and linked in as bytecode,
+  so nothing is parsed at boot. scripts get the base, coroutine, table, string, math & utf8 libraries,
+  plus the kernel's own term, memory & initrd libraries (there's no io or os, and no filesystem to load anything else from)
+ */
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+// creates the lua state and runs the embedded boot chunk on this cpu. errors are printed, not fatal.
+// needs the heap, so only after memory_init
+void script_runBoot();
+
+#endif
@@ -0,0 +1,182 @@
+/* serial.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "apic.h"
+#include "interrupts.h"
+#include "serial.h"
+
+#define COM1 0x3F8
+#define COM1_IRQ 4
+
+// register offsets from the base port
+#define UART_DATA          0   // THR when written
+#define UART_INTERRUPTS    1   // IER
+#define UART_DIVISOR_LOW   0   // while LCR_DLAB is set
+#define UART_DIVISOR_HIGH  1
+#define UART_FIFO_CONTROL  2   // FCR when written, IIR when read
+#define UART_LINE_CONTROL  3
+#define UART_MODEM_CONTROL 4
+#define UART_LINE_STATUS   5
+#define UART_SCRATCH       7
+
+#define IER_TRANSMIT_EMPTY (1 << 1)
+#define LCR_8N1            0x03
+#define LCR_DLAB           0x80
+#define FCR_ENABLE_CLEAR   0x07    // enable & clear both FIFOs, 1 byte receive trigger
+#define MCR_DTR_RTS_OUT2   0x0B    // OUT2 connects the UART's interrupt line
+#define LSR_TRANSMIT_EMPTY (1 << 5)
+#define IIR_NONE_PENDING   (1 << 0)
+#define UART_FIFO_SIZE     16
+
+#define RING_MASK (SERIAL_RING_SIZE - 1)
+#define SLOT_FULL 0x100
+
+// every slot holds one byte plus SLOT_FULL once a writer has filled it in. writers claim a run of slots by moving
+// reserved forward, so they never wait for each other. the single consumer stops at the first slot that isn't full yet
+static volatile uint16_t ring[SERIAL_RING_SIZE];
+static volatile uint64_t reserved;  // next slot a writer can claim
+static volatile uint64_t consumed;  // next slot to send, everything before it is free again
+static volatile uint64_t dropped;
+
+static int present;
+static int interrupt_driven;
+// set while the transmitter-empty interrupt is enabled (or being enabled), so only one writer turns it on
+static volatile uint32_t transmitting;
+// only one cpu takes bytes out of the ring at a time
+static volatile uint32_t draining;
+
+static void write_slot(uint64_t index, uint8_t byte) {
+    __atomic_store_n(&ring[index & RING_MASK], byte | SLOT_FULL, __ATOMIC_RELEASE);
+}
+
+// moves up to budget bytes from the ring to the UART. returns whether it stopped because the ring ran out
+static int drain(int budget) {
+    if(__atomic_exchange_n(&draining, 1, __ATOMIC_ACQUIRE)) return 0;
+    uint64_t index = consumed;
+    int empty = 0;
+    while(budget > 0) {
+        uint16_t slot = __atomic_load_n(&ring[index & RING_MASK], __ATOMIC_ACQUIRE);
+        if(!(slot & SLOT_FULL)) {
+            empty = 1;
+            break;
+        }
+        ring[index & RING_MASK] = 0;
+        cpu_outb(COM1 + UART_DATA, slot & 0xff);
+        index++;
+        budget--;
+    }
+    __atomic_store_n(&consumed, index, __ATOMIC_RELEASE); // frees the slots for writers
+    __atomic_store_n(&draining, 0, __ATOMIC_RELEASE);
+    return empty;
+}
+
+static int ring_has_data() {
+    return (__atomic_load_n(&ring[consumed & RING_MASK], __ATOMIC_ACQUIRE) & SLOT_FULL) != 0;
+}
+
+static void start_transmitting() {
+    if(!__atomic_exchange_n(&transmitting, 1, __ATOMIC_SEQ_CST)) {
+        // the UART raises the interrupt as soon as this is set, since the transmitter is already empty
+        cpu_outb(COM1 + UART_INTERRUPTS, IER_TRANSMIT_EMPTY);
+    }
+}
+
+static void serial_interrupt(interrupt_frame* frame) {
+    (void) frame;
+    while(!(cpu_inb(COM1 + UART_FIFO_CONTROL) & IIR_NONE_PENDING)) { // reading IIR acknowledges it
+        if(!(cpu_inb(COM1 + UART_LINE_STATUS) & LSR_TRANSMIT_EMPTY)) continue;
+        if(drain(UART_FIFO_SIZE)) {
+            // nothing left, stop the interrupt. a writer that added something after drain looked
+            // saw transmitting still set and didn't start it again, so check once more
+            cpu_outb(COM1 + UART_INTERRUPTS, 0);
+            __atomic_store_n(&transmitting, 0, __ATOMIC_SEQ_CST);
+            if(ring_has_data()) start_transmitting();
+            break;
+        }
+    }
+}
+
+int serial_init() {
+    cpu_outb(COM1 + UART_SCRATCH, 0x5A);
+    if(cpu_inb(COM1 + UART_SCRATCH) != 0x5A) return 0;
+
+    cpu_outb(COM1 + UART_INTERRUPTS, 0);
+    cpu_outb(COM1 + UART_LINE_CONTROL, LCR_DLAB);
+    cpu_outb(COM1 + UART_DIVISOR_LOW, 1); // 115200 / 1
+    cpu_outb(COM1 + UART_DIVISOR_HIGH, 0);
+    cpu_outb(COM1 + UART_LINE_CONTROL, LCR_8N1);
+    cpu_outb(COM1 + UART_FIFO_CONTROL, FCR_ENABLE_CLEAR);
+    cpu_outb(COM1 + UART_MODEM_CONTROL, MCR_DTR_RTS_OUT2);
+    present = 1;
+    return 1;
+}
+
+int serial_present() {
+    return present;
+}
+
+void serial_enableInterrupts() {
+    if(!present) return;
+    interrupts_setHandler(INTERRUPT_IRQ_BASE + COM1_IRQ, serial_interrupt);
+    if(!apic_routeIsaIrq(COM1_IRQ, INTERRUPT_IRQ_BASE + COM1_IRQ, apic_localId())) return;
+    interrupt_driven = 1;
+    // the UART may have raised its (edge triggered) interrupt while it wasn't routed anywhere, so raise it again
+    cpu_outb(COM1 + UART_INTERRUPTS, 0);
+    __atomic_store_n(&transmitting, 0, __ATOMIC_SEQ_CST);
+    if(ring_has_data()) start_transmitting();
+}
+
+int serial_write(const char* data, uint64_t length) {
+    if(!present) return 0;
+
+    uint64_t size = length;
+    for(uint64_t i = 0; i < length; i++) {
+        if(data[i] == '\n') size++;
+    }
+    uint64_t start = __atomic_load_n(&reserved, __ATOMIC_RELAXED);
+    do {
+        if(start + size - __atomic_load_n(&consumed, __ATOMIC_ACQUIRE) > SERIAL_RING_SIZE) {
+            __atomic_add_fetch(&dropped, length, __ATOMIC_RELAXED);
+            return 0;
+        }
+    } while(!__atomic_compare_exchange_n(&reserved, &start, start + size, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+    uint64_t index = start;
+    for(uint64_t i = 0; i < length; i++) {
+        if(data[i] == '\n') write_slot(index++, '\r');
+        write_slot(index++, data[i]);
+    }
+
+    if(interrupt_driven) {
+        start_transmitting();
+    } else if(cpu_inb(COM1 + UART_LINE_STATUS) & LSR_TRANSMIT_EMPTY) {
+        drain(UART_FIFO_SIZE); // whatever fits right now, the rest goes out with later writes
+    }
+    return 1;
+}
+
+void serial_flush() {
+    if(!present) return;
+    while(ring_has_data()) {
+        while(!(cpu_inb(COM1 + UART_LINE_STATUS) & LSR_TRANSMIT_EMPTY)) {
+            cpu_pause();
+        }
+        drain(UART_FIFO_SIZE);
+    }
+}
+
+uint64_t serial_droppedCount() {
+    return dropped;
+}
@@ -0,0 +1,40 @@
+/* serial.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  output on the COM1 16550 UART. writers copy into a lock-free ring and return,
+  the transmitter-empty interrupt moves it to the UART 16 bytes (one FIFO) at a time.
+  until serial_enableInterrupts, each write sends whatever fits in the FIFO right then and the rest waits in the ring
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+
+// must be a power of two
+#define SERIAL_RING_SIZE 65536
+
+// sets up the UART (115200 8N1). returns 0 if there isn't one
+int serial_init();
+int serial_present();
+// routes the UART's interrupt to this cpu and starts draining the ring.
+// without an IO APIC, writes drain whatever fits in the FIFO themselves instead
+void serial_enableInterrupts();
+
+// safe from any cpu & from interrupt handlers, never waits for the UART. '\n' is sent as "\r\n".
+// returns 0 (and drops the whole string) if the ring doesn't have room
+int serial_write(const char* data, uint64_t length);
+// sends everything in the ring by polling, for when interrupts can't be relied on (like before halting)
+void serial_flush();
+// bytes dropped because the ring was full
+uint64_t serial_droppedCount();
+
+#endif
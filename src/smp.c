@@ -0,0 +1,129 @@
+/* smp.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "mem.h"
+#include "term.h"
+#include "kprintf.h"
+#include "klog.h"
+#include "apic.h"
+#include "clock.h"
+#include "percpu.h"
+#include "sched.h"
+#include "interrupts.h"
+#include "phys.h"
+#include "memory_manager.h"
+#include "smp.h"
+
+// smp_trampoline.S, see there for what each field is
+extern uint8_t smp_trampoline_start[];
+extern uint8_t smp_trampoline_end[];
+extern uint8_t smp_trampoline_long_mode[];
+extern uint8_t smp_trampoline_gdt[];
+extern uint8_t smp_trampoline_gdt_ptr[];
+extern uint8_t smp_trampoline_far_pointer[];
+extern uint8_t smp_trampoline_low_cr3[];
+extern uint8_t smp_trampoline_cr3[];
+extern uint8_t smp_trampoline_stack[];
+extern uint8_t smp_trampoline_cpu[];
+extern uint8_t smp_trampoline_entry[];
+
+// a field of the copy of the trampoline in low memory
+#define TRAMPOLINE_FIELD(type, label) (*(type*) (trampoline + ((label) - smp_trampoline_start)))
+
+static uint8_t* trampoline;
+
+__attribute__((noreturn))
+static void ap_entry(cpu_data* cpu) {
+    cpu_enableAvx();
+    memory_initCpu();
+    percpu_load(cpu);
+    interrupts_load();
+    apic_enableLocal();
+    __atomic_store_n(&cpu->online, 1, __ATOMIC_RELEASE);
+    sched_workerLoop();
+}
+
+static int wait_online(cpu_data* cpu, uint64_t timeout_us) {
+    uint64_t deadline = time_now_ns() + timeout_us * 1000;
+    while(time_now_ns() < deadline) {
+        if(__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE)) return 1;
+        cpu_pause();
+    }
+    return 0;
+}
+
+static int start_cpu(uint32_t apic_id) {
+    cpu_data* cpu = percpu_create(apic_id);
+    if(!cpu) return 0;
+    TRAMPOLINE_FIELD(uint64_t, smp_trampoline_stack) = cpu->stack_top;
+    TRAMPOLINE_FIELD(uint64_t, smp_trampoline_cpu) = (uint64_t) cpu;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    // the startup IPI's vector is the page number of where to start
+    uint8_t vector = (uint64_t) trampoline >> 12;
+    apic_sendInit(apic_id);
+    time_delay_ms(10);
+    apic_sendStartup(apic_id, vector);
+    if(!wait_online(cpu, 1000)) {
+        // the second one is only needed on some older cpus, it's ignored if the first one worked
+        apic_sendStartup(apic_id, vector);
+        if(!wait_online(cpu, 100000)) {
+            // its memory is leaked on purpose, the cpu might still wake up late and use it
+            return 0;
+        }
+    }
+    percpu_register(cpu);
+    return 1;
+}
+
+int smp_init() {
+    cpu_data* bsp = cpu_current();
+    if(!apic_init()) {
+        term_write("smp: no MADT, only using one cpu\n");
+        return 1;
+    }
+    bsp->apic_id = apic_localId();
+
+    uint64_t low_memory = memory_lowMemory();
+    if(!low_memory) {
+        term_write("smp: no memory below 1 MiB for the trampoline, only using one cpu\n");
+        return 1;
+    }
+
+    // the first page is the trampoline, the second a copy of the top level page table.
+    // cr3 can only be loaded with a 32-bit value in real mode, and the real one might be above 4 GiB.
+    // the lower levels are shared, and the cpu switches to the real one once it's in long mode
+    trampoline = (uint8_t*) low_memory;
+    uint64_t* low_page_map = (uint64_t*) (low_memory + 4096);
+    memcpy(trampoline, smp_trampoline_start, smp_trampoline_end - smp_trampoline_start);
+    memcpy(low_page_map, memory_pageMap(), 4096);
+    TRAMPOLINE_FIELD(uint32_t, smp_trampoline_gdt_ptr + 2) = low_memory + (smp_trampoline_gdt - smp_trampoline_start);
+    TRAMPOLINE_FIELD(uint32_t, smp_trampoline_far_pointer) = low_memory + (smp_trampoline_long_mode - smp_trampoline_start);
+    TRAMPOLINE_FIELD(uint32_t, smp_trampoline_low_cr3) = (uint64_t) low_page_map;
+    TRAMPOLINE_FIELD(uint64_t, smp_trampoline_cr3) = virt_to_phys(memory_pageMap());
+    TRAMPOLINE_FIELD(uint64_t, smp_trampoline_entry) = (uint64_t) ap_entry;
+
+    // one at a time, they all share the trampoline
+    for(int i = 0; i < apic_processorCount(); i++) {
+        uint32_t apic_id = apic_processorId(i);
+        if(apic_id == bsp->apic_id) continue;
+        if(!start_cpu(apic_id)) {
+            klog(KLOG_WARN, "smp: cpu with apic id %u didn't start", apic_id);
+        }
+    }
+
+    kprintf("smp: %d of %d cpus running\n", percpu_count(), apic_processorCount());
+    return percpu_count();
+}
@@ -0,0 +1,22 @@
+/* smp.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  starts the other cpus (application processors) with INIT-SIPI-SIPI.
+  once started they run sched_workerLoop, waiting for tasks
+ */
+
+#ifndef SMP_H
+#define SMP_H
+
+// needs the memory manager, clock and ACPI. returns how many cpus are running, including this one
+int smp_init();
+
+#endif
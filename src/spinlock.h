@@ -0,0 +1,39 @@
+/* spinlock.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  test-and-test-and-set spinlock. waiters spin on a plain load so the cache line
+  stays shared until the holder releases it, instead of bouncing it with every attempt.
+ */
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+typedef struct {
+    volatile uint32_t locked;
+} spinlock;
+
+static inline void spinlock_acquire(spinlock* lock) {
+    while(__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+        while(__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            cpu_pause();
+        }
+    }
+}
+
+static inline void spinlock_release(spinlock* lock) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+#endif
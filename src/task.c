@@ -0,0 +1,219 @@
+/* task.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "heap.h"
+#include "clock.h"
+#include "klog.h"
+#include "percpu.h"
+#include "memory_manager.h"
+#include "task.h"
+
+// task_asm.S
+extern void task_switch(uint64_t* save_rsp, uint64_t new_rsp);
+
+// what a new task starts with, the same as after a reset
+#define DEFAULT_MXCSR       0x1F80
+#define DEFAULT_FPU_CONTROL 0x037F
+
+// the queue is only ever changed with its lock held & interrupts off (so a handler on the same cpu can't try to take
+// the lock too). a switch happens with the lock held: the task that gets switched to releases it
+
+void task_initQueue(task_queue* queue, uint32_t cpu) {
+    queue->boot.state = TASK_RUNNING;
+    queue->boot.cpu = cpu;
+    queue->current = &queue->boot;
+}
+
+static task_queue* this_queue() {
+    return &cpu_current()->tasks;
+}
+
+static uint64_t lock_queue(task_queue* queue) {
+    uint64_t flags = cpu_disableInterrupts();
+    spinlock_acquire(&queue->lock);
+    return flags;
+}
+
+static void unlock_queue(task_queue* queue, uint64_t flags) {
+    spinlock_release(&queue->lock);
+    cpu_restoreInterrupts(flags);
+}
+
+static void push_ready(task_queue* queue, task* ready) {
+    ready->state = TASK_READY;
+    ready->next = 0;
+    if(queue->ready_tail) {
+        queue->ready_tail->next = ready;
+    } else {
+        queue->ready_head = ready;
+    }
+    queue->ready_tail = ready;
+}
+
+static task* pop_ready(task_queue* queue) {
+    task* ready = queue->ready_head;
+    if(ready) {
+        queue->ready_head = ready->next;
+        if(!queue->ready_head) queue->ready_tail = 0;
+    }
+    return ready;
+}
+
+// moves the sleepers whose time has come to the run queue
+static void wake_sleepers(task_queue* queue) {
+    if(!queue->sleeping) return;
+    uint64_t now = time_now_ns();
+    while(queue->sleeping && queue->sleeping->wake_time <= now) {
+        task* sleeper = queue->sleeping;
+        queue->sleeping = sleeper->next;
+        push_ready(queue, sleeper);
+    }
+}
+
+// the first thing a task does after being switched to: unlock the queue, and free the task that switched here
+// if it was returning (nothing runs on its stack anymore)
+static void finish_switch(task_queue* queue, uint64_t flags) {
+    task* dead = queue->dead;
+    queue->dead = 0;
+    unlock_queue(queue, flags);
+    if(dead) {
+        memory_freePages(dead->stack);
+        kfree(dead);
+    }
+}
+
+// switches to the next ready task. called with the queue locked and the current task's state already changed
+// (& queued or listed wherever it should be). returns once the current task is switched back to, with the queue unlocked
+static void reschedule(task_queue* queue, uint64_t flags) {
+    task* previous = queue->current;
+    task* next;
+    while(!(next = pop_ready(queue))) {
+        wake_sleepers(queue);
+        if(queue->ready_head) continue;
+        // nothing can run. wait on the current stack with the queue unlocked, so other cpus & interrupts can wake something
+        unlock_queue(queue, flags);
+        if(!klog_drain()) {
+            for(int i = 0; i < 64; i++) cpu_pause();
+        }
+        lock_queue(queue);
+    }
+    next->state = TASK_RUNNING;
+    if(next != previous) {
+        queue->current = next;
+        queue->switches++;
+        queue->switch_flags = flags;
+        task_switch(&previous->rsp, next->rsp);
+        // some later switch came back here
+    }
+    finish_switch(queue, flags);
+}
+
+__attribute__((noreturn))
+static void task_entry() {
+    task_queue* queue = this_queue();
+    task* self = queue->current;
+    finish_switch(queue, queue->switch_flags);
+    self->function(self->argument);
+
+    uint64_t flags = lock_queue(queue);
+    self->state = TASK_DEAD;
+    queue->dead = self;
+    reschedule(queue, flags);
+    __builtin_unreachable();
+}
+
+task* task_create(void (*function)(void* argument), void* argument) {
+    task* created = kmalloc(sizeof(task));
+    uint64_t* stack = memory_allocatePages(TASK_STACK_PAGES);
+    if(!created || !stack) {
+        if(created) kfree(created);
+        if(stack) memory_freePages(stack);
+        return 0;
+    }
+    // what task_switch would have left on the stack, so switching to it "returns" into task_entry
+    uint64_t* top = stack + TASK_STACK_PAGES * 4096 / sizeof(uint64_t);
+    top[-1] = 0;                        // task_entry's own return address, it never returns
+    top[-2] = (uint64_t) task_entry;
+    for(int i = 3; i <= 8; i++) {
+        top[-i] = 0;                    // rbp, rbx, r12 - r15
+    }
+    top[-9] = DEFAULT_MXCSR | ((uint64_t) DEFAULT_FPU_CONTROL << 32);
+
+    task_queue* queue = this_queue();
+    *created = (task) {
+        .rsp = (uint64_t) &top[-9],
+        .function = function,
+        .argument = argument,
+        .stack = stack,
+        .cpu = cpu_current()->index
+    };
+    uint64_t flags = lock_queue(queue);
+    push_ready(queue, created);
+    unlock_queue(queue, flags);
+    return created;
+}
+
+task* task_current() {
+    return this_queue()->current;
+}
+
+void task_yield() {
+    task_queue* queue = this_queue();
+    uint64_t flags = lock_queue(queue);
+    wake_sleepers(queue);
+    if(!queue->ready_head) {
+        unlock_queue(queue, flags);
+        return;
+    }
+    push_ready(queue, queue->current);
+    reschedule(queue, flags);
+}
+
+void task_sleep(uint64_t ns) {
+    task_queue* queue = this_queue();
+    task* self = queue->current;
+    self->wake_time = time_now_ns() + ns;
+    uint64_t flags = lock_queue(queue);
+    task** link = &queue->sleeping;
+    while(*link && (*link)->wake_time <= self->wake_time) link = &(*link)->next;
+    self->next = *link;
+    *link = self;
+    self->state = TASK_SLEEPING;
+    reschedule(queue, flags);
+}
+
+void task_suspend() {
+    task_queue* queue = this_queue();
+    uint64_t flags = lock_queue(queue);
+    task* self = queue->current;
+    if(self->wake_pending) {
+        self->wake_pending = 0;
+        unlock_queue(queue, flags);
+        return;
+    }
+    self->state = TASK_SUSPENDED;
+    reschedule(queue, flags);
+}
+
+void task_wake(task* sleeper) {
+    task_queue* queue = &percpu_get(sleeper->cpu)->tasks;
+    uint64_t flags = lock_queue(queue);
+    if(sleeper->state == TASK_SUSPENDED) {
+        push_ready(queue, sleeper);
+    } else {
+        sleeper->wake_pending = 1;
+    }
+    unlock_queue(queue, flags);
+}
@@ -0,0 +1,78 @@
+/* task.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  cooperative kernel tasks. each task has its own stack and stays on the cpu that created it,
+  and only gives up the cpu in task_yield, task_sleep, task_suspend or by returning.
+  each cpu's own context (the one it booted on) is a task too, so it can suspend & sleep like the others.
+  a switch is a function call, so only the registers the ABI says survive a call have to be saved:
+  the callee-saved ones, mxcsr and the x87 control word. the xmm & x87 registers are dead across the call,
+  so there's no SSE state to switch, lazily or otherwise
+ */
+
+#ifndef TASK_H
+#define TASK_H
+
+#include <stdint.h>
+
+#include "spinlock.h"
+
+#define TASK_STACK_PAGES 4
+
+#define TASK_RUNNING    0   // the cpu's current task
+#define TASK_READY      1   // in the run queue
+#define TASK_SUSPENDED  2   // waiting for task_wake
+#define TASK_SLEEPING   3   // waiting for its wake time
+#define TASK_DEAD       4   // returned, its memory is freed once the cpu has switched away from it
+
+typedef struct task {
+    uint64_t rsp;               // while it isn't running. task_switch pushed the rest of the context there
+    struct task* next;          // in the run queue or sleep list
+    void (*function)(void* argument);
+    void* argument;
+    void* stack;                // 0 for a cpu's boot context, which keeps the stack it came with
+    uint64_t wake_time;         // time_now_ns to wake up at, while sleeping
+    uint32_t state;
+    uint32_t wake_pending;      // a task_wake that came before the task suspended
+    uint32_t cpu;               // index of the cpu it runs on
+} task;
+
+// every cpu's tasks, in its cpu_data
+typedef struct {
+    spinlock lock;              // other cpus & interrupt handlers can wake tasks, so the queue is locked
+    task* current;
+    task* ready_head;           // runnable tasks waiting for a turn, oldest first
+    task* ready_tail;
+    task* sleeping;             // soonest wake time first
+    task* dead;                 // the task that just returned, freed by whichever task runs next
+    uint64_t switch_flags;      // interrupt flag of the task that switched, for a new task to start with
+    uint64_t switches;
+    task boot;                  // the context the cpu was in before its first switch
+} task_queue;
+
+// sets up an empty queue with the cpu's current context as its running task
+void task_initQueue(task_queue* queue, uint32_t cpu);
+
+// creates a task on this cpu, it runs once the current task gives up the cpu. needs the heap.
+// returns 0 if out of memory. the task is freed when function returns, don't use the pointer after that
+task* task_create(void (*function)(void* argument), void* argument);
+task* task_current();
+
+// lets the other ready tasks on this cpu run, returns right away if there aren't any
+void task_yield();
+// gives up the cpu for at least ns nanoseconds
+void task_sleep(uint64_t ns);
+// gives up the cpu until task_wake. returns right away if it was already woken since it last suspended
+void task_suspend();
+// makes a suspended task ready again (or makes its next task_suspend return right away).
+// safe from any cpu & from interrupt handlers. doesn't cut a task_sleep short
+void task_wake(task* sleeper);
+
+#endif
@@ -12,7 +12,15 @@
 
 #include "term.h"
 #include "font.h"
+#include "font_masks.h"
+#include "cpu.h"
+#include "spinlock.h"
+#include "serial.h"
 #include <stdint.h>
+#include <immintrin.h>
+
+// held for each write/flush/scroll call, so output from different cpus doesn't tear mid-call
+static spinlock term_lock;
 
 static uint8_t fb_ready = 0;
 static volatile uint32_t* fb;   // indexed by pixel (not byte)
@@ -20,17 +28,69 @@ static int fb_width;    // width in characters
 static int fb_height;   // height in characters
 static int fb_ppl;      // pixels per line (not always equal to framebuffer width)
 
+// once set, glyphs are drawn here and only changed parts get copied to fb by term_flush.
+// it's a ring of character rows (strips) laid out like fb, screen row 0 is the strip at strip_top
+static uint32_t* back_buffer;
+static int strip_top;
+// range of changed characters in each screen row, dirty_end <= dirty_begin means the row is clean
+static uint16_t* dirty_begin;
+static uint16_t* dirty_end;
+// the screen scrolled since the last flush, so every row is dirty
+static uint8_t scrolled;
+// strips that have to be redrawn from the cells before flushing. indexed by strip, so the flags move with scrolling
+static uint8_t* strip_stale;
+// set when the back buffer has changes term_flush hasn't copied to the framebuffer yet
+static volatile uint8_t flush_pending;
+// until something drains the log regularly, every write flushes itself so a hang doesn't leave a stale screen
+static uint8_t flush_on_write = 1;
+// even after that, a write flushes if nothing else has for this long (a few ms at a few GHz)
+#define FLUSH_INTERVAL_CYCLES (1ull << 24)
+static uint64_t last_flush;
+
+// text of the screen and the scrollback history, also a ring of rows. screen row 0 is cell row ring_top
+typedef struct {
+    uint32_t foreground;
+    uint32_t background;
+    uint8_t glyph;
+} term_cell;
+static term_cell* cells;
+static int ring_rows;
+static int ring_top;
+static int history_rows;    // how many rows above ring_top hold history
+static int view_offset;     // how many rows the view is scrolled back into the history
+
 static int cursor_x;
 static int cursor_y;
 
+static int output = TERM_OUTPUT_FRAMEBUFFER;
+// characters for the serial port, sent in one go at the end of each write call so it is one ring reservation
+static char serial_pending[256];
+static int serial_pending_length;
+
 uint32_t foreground_color, background_color;
 
+// glyphs already blended with a (foreground, background) pair, so drawing one is just copying 8 rows of 8 pixels.
+// a glyph is colored the first time it's drawn with a pair, and the least recently added pair is replaced when they're all in use
+#define GLYPH_CACHE_PAIRS 4
+typedef struct {
+    __attribute__((aligned(32))) uint32_t pixels[256][FONT_HEIGHT * FONT_WIDTH];
+    uint32_t colored[256 / 32];     // bit per glyph
+    uint32_t foreground;
+    uint32_t background;
+    uint8_t used;
+} glyph_colors;
+static glyph_colors glyph_cache[GLYPH_CACHE_PAIRS];
+static int glyph_cache_next;
+
+static uint8_t has_avx2;
+
 // width/height are in pixels, ppl is pixels per line
 void term_init(volatile uint32_t* in_fb, int width, int height, int ppl) {
     fb = in_fb;
     fb_width = width / FONT_WIDTH;
     fb_height = height / FONT_HEIGHT;
     fb_ppl = ppl;
+    has_avx2 = cpu_hasAvx2();
 
     term_setCursorPos(0, 0);
     term_setTextColor(COLORS_WHITE);
@@ -39,6 +99,262 @@ void term_init(volatile uint32_t* in_fb, int width, int height, int ppl) {
     fb_ready = 1;
 }
 
+// these run for every character, so they wrap with a compare instead of dividing
+static inline int strip_index(int row) {
+    int index = strip_top + row;
+    return index >= fb_height ? index - fb_height : index;
+}
+
+static inline uint32_t* strip(int row) {
+    return &back_buffer[strip_index(row) * FONT_HEIGHT * fb_ppl];
+}
+
+// cell row of a screen row, offset is how many rows back into the history
+static inline term_cell* cell_row(int row, int offset) {
+    int index = ring_top + row - offset;
+    if(index < 0) index += ring_rows;
+    else if(index >= ring_rows) index -= ring_rows;
+    return &cells[index * fb_width];
+}
+
+uint64_t term_backBufferSize() {
+    return (uint64_t) fb_height * FONT_HEIGHT * fb_ppl * sizeof(uint32_t)
+        + (uint64_t) (fb_height + TERM_HISTORY_ROWS) * fb_width * sizeof(term_cell)
+        + fb_height * (2 * sizeof(uint16_t) + sizeof(uint8_t));
+}
+
+void term_setBackBuffer(void* buffer) {
+    back_buffer = buffer;
+    cells = (term_cell*) &back_buffer[fb_height * FONT_HEIGHT * fb_ppl];
+    ring_rows = fb_height + TERM_HISTORY_ROWS;
+    dirty_begin = (uint16_t*) &cells[ring_rows * fb_width];
+    dirty_end = &dirty_begin[fb_height];
+    strip_stale = (uint8_t*) &dirty_end[fb_height];
+
+    strip_top = 0;
+    scrolled = 0;
+    ring_top = 0;
+    history_rows = 0;
+    view_offset = 0;
+
+    // start with what's already on screen. reading the framebuffer is slow, but this only happens once.
+    // the text that was drawn before now isn't known, so it's blank in the cells
+    for(int i = 0; i < fb_height * FONT_HEIGHT * fb_ppl; i++) {
+        back_buffer[i] = fb[i];
+    }
+    for(int i = 0; i < ring_rows * fb_width; i++) {
+        cells[i] = (term_cell) { foreground_color, background_color, ' ' };
+    }
+    for(int row = 0; row < fb_height; row++) {
+        dirty_begin[row] = 0;
+        dirty_end[row] = 0;
+        strip_stale[row] = 0;
+    }
+}
+
+static glyph_colors* find_colors(uint32_t foreground, uint32_t background) {
+    for(int i = 0; i < GLYPH_CACHE_PAIRS; i++) {
+        glyph_colors* colors = &glyph_cache[i];
+        if(colors->used && colors->foreground == foreground && colors->background == background) return colors;
+    }
+    glyph_colors* colors = &glyph_cache[glyph_cache_next];
+    glyph_cache_next = (glyph_cache_next + 1) % GLYPH_CACHE_PAIRS;
+    colors->foreground = foreground;
+    colors->background = background;
+    colors->used = 1;
+    for(int i = 0; i < 256 / 32; i++) {
+        colors->colored[i] = 0;
+    }
+    return colors;
+}
+
+// (foreground & mask) | (background & ~mask), 4 pixels at a time
+static void color_glyph(uint32_t* pixels, uint8_t glyph, uint32_t foreground, uint32_t background) {
+    __m128i fg = _mm_set1_epi32(foreground);
+    __m128i bg = _mm_set1_epi32(background);
+    for(int y = 0; y < FONT_HEIGHT; y++) {
+        const __m128i* mask = (const __m128i*) font_row_masks[font[glyph][y]];
+        for(int x = 0; x < FONT_WIDTH / 4; x++) {
+            __m128i m = _mm_load_si128(&mask[x]);
+            _mm_store_si128((__m128i*) &pixels[y * FONT_WIDTH + x * 4], _mm_or_si128(_mm_and_si128(m, fg), _mm_andnot_si128(m, bg)));
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+static void copy_glyph_avx2(uint32_t* target, const uint32_t* pixels) {
+    for(int y = 0; y < FONT_HEIGHT; y++) {
+        _mm256_storeu_si256((__m256i*) &target[y * fb_ppl], _mm256_load_si256((const __m256i*) &pixels[y * FONT_WIDTH]));
+    }
+}
+
+static void copy_glyph_sse2(uint32_t* target, const uint32_t* pixels) {
+    for(int y = 0; y < FONT_HEIGHT; y++) {
+        _mm_storeu_si128((__m128i*) &target[y * fb_ppl], _mm_load_si128((const __m128i*) &pixels[y * FONT_WIDTH]));
+        _mm_storeu_si128((__m128i*) &target[y * fb_ppl + 4], _mm_load_si128((const __m128i*) &pixels[y * FONT_WIDTH + 4]));
+    }
+}
+
+// target is fb_ppl pixels per line, like the framebuffer
+static void draw_colored(uint32_t* target, uint8_t glyph, glyph_colors* colors) {
+    uint32_t* pixels = colors->pixels[glyph];
+    if(!(colors->colored[glyph / 32] & (1u << (glyph % 32)))) {
+        color_glyph(pixels, glyph, colors->foreground, colors->background);
+        colors->colored[glyph / 32] |= 1u << (glyph % 32);
+    }
+    if(has_avx2) {
+        copy_glyph_avx2(target, pixels);
+    } else {
+        copy_glyph_sse2(target, pixels);
+    }
+}
+
+static void draw_glyph(uint32_t* target, uint8_t glyph, uint32_t foreground, uint32_t background) {
+    draw_colored(target, glyph, find_colors(foreground, background));
+}
+
+// a whole row of cells, only looking the colors up again when they change
+static void draw_row(uint32_t* target, term_cell* line) {
+    glyph_colors* colors = 0;
+    for(int x = 0; x < fb_width; x++) {
+        if(!colors || colors->foreground != line[x].foreground || colors->background != line[x].background) {
+            colors = find_colors(line[x].foreground, line[x].background);
+        }
+        draw_colored(&target[x * FONT_WIDTH], line[x].glyph, colors);
+    }
+}
+
+// copies pixels with non-temporal stores, so the framebuffer writes are combined & don't evict anything from the cache
+static void copy_streaming(volatile uint32_t* destination, uint32_t* source, int count) {
+    int i = 0;
+    if(((uint64_t) destination & 0xf) == 0) { // movntdq needs 16-byte alignment
+        for(; i + 4 <= count; i += 4) {
+            asm volatile("movdqu (%1), %%xmm0\n\t"
+                         "movntdq %%xmm0, (%0)"
+                         : : "r"(&destination[i]), "r"(&source[i]) : "xmm0", "memory");
+        }
+    }
+    for(; i < count; i++) {
+        asm volatile("movnti %1, (%0)" : : "r"(&destination[i]), "r"(source[i]) : "memory");
+    }
+}
+
+static void mark_dirty(int x, int y) {
+    if(dirty_end[y] <= dirty_begin[y]) {
+        dirty_begin[y] = x;
+        dirty_end[y] = x + 1;
+    } else if(x < dirty_begin[y]) {
+        dirty_begin[y] = x;
+    } else if(x >= dirty_end[y]) {
+        dirty_end[y] = x + 1;
+    }
+}
+
+static void mark_all_stale() {
+    for(int row = 0; row < fb_height; row++) {
+        strip_stale[row] = 1;
+    }
+    flush_pending = 1;
+}
+
+static void send_serial() {
+    if(serial_pending_length) serial_write(serial_pending, serial_pending_length);
+    serial_pending_length = 0;
+}
+
+static void flush() {
+    send_serial();
+    if(!back_buffer) return;
+    flush_pending = 0;
+    last_flush = cpu_readTsc();
+
+    for(int row = 0; row < fb_height; row++) {
+        if(strip_stale[strip_index(row)]) {
+            draw_row(strip(row), cell_row(row, view_offset));
+            strip_stale[strip_index(row)] = 0;
+            dirty_begin[row] = 0;
+            dirty_end[row] = fb_width;
+        }
+        if(scrolled) {
+            dirty_begin[row] = 0;
+            dirty_end[row] = fb_width;
+        }
+        if(dirty_end[row] <= dirty_begin[row]) continue;
+
+        int x = dirty_begin[row] * FONT_WIDTH;
+        int count = (dirty_end[row] - dirty_begin[row]) * FONT_WIDTH;
+        uint32_t* source = strip(row);
+        for(int y = 0; y < FONT_HEIGHT; y++) {
+            copy_streaming(&fb[(row * FONT_HEIGHT + y) * fb_ppl + x], &source[y * fb_ppl + x], count);
+        }
+        dirty_begin[row] = 0;
+        dirty_end[row] = 0;
+    }
+    scrolled = 0;
+    asm volatile("sfence" : : : "memory"); // non-temporal stores aren't ordered with anything else
+}
+
+// the end of every write call
+static void finish_write() {
+    if(flush_pending && (flush_on_write || cpu_readTsc() - last_flush > FLUSH_INTERVAL_CYCLES)) {
+        flush();
+    } else {
+        send_serial();
+    }
+}
+
+void term_setFlushOnWrite(int enabled) {
+    flush_on_write = enabled;
+}
+
+void term_flush() {
+    if(!flush_pending) return; // called whenever the log is drained, which is mostly when there's nothing new
+    spinlock_acquire(&term_lock);
+    flush();
+    spinlock_release(&term_lock);
+}
+
+void term_scroll(int lines) {
+    if(!back_buffer) return;
+
+    spinlock_acquire(&term_lock);
+    int offset = view_offset + lines;
+    if(offset < 0) offset = 0;
+    if(offset > history_rows) offset = history_rows;
+    if(offset != view_offset) {
+        view_offset = offset;
+        mark_all_stale();
+        flush();
+    }
+    spinlock_release(&term_lock);
+}
+
+// move everything up one row. the top row goes into the history instead of being copied anywhere
+static void scroll_up() {
+    ring_top = (ring_top + 1) % ring_rows;
+    if(history_rows < TERM_HISTORY_ROWS) history_rows++;
+    strip_top = (strip_top + 1) % fb_height;
+
+    // the new bottom row is whatever fell off the end of the history, so clear it.
+    // its strip is only drawn when it's flushed, so lines that scroll away before then are never drawn at all
+    int bottom = fb_height - 1;
+    term_cell* line = cell_row(bottom, 0);
+    for(int x = 0; x < fb_width; x++) {
+        line[x] = (term_cell) { foreground_color, background_color, ' ' };
+    }
+    strip_stale[strip_index(bottom)] = 1;
+
+    // every row of the screen moved, but the strips are already right
+    scrolled = 1;
+    flush_pending = 1;
+}
+
+void term_setOutput(int new_output) {
+    spinlock_acquire(&term_lock);
+    output = serial_present() ? new_output : TERM_OUTPUT_FRAMEBUFFER;
+    spinlock_release(&term_lock);
+}
+
 void term_setCursorPos(int x, int y) {
     if (x >= 0 && x < fb_width) {
         cursor_x = x;
@@ -55,10 +371,23 @@ void term_setBackgroundColor(int color) {
 }
 
 static int putC(char glyph) {
+    if (output & TERM_OUTPUT_SERIAL) {
+        if (serial_pending_length == sizeof(serial_pending)) send_serial();
+        serial_pending[serial_pending_length++] = glyph;
+    }
+    if (!(output & TERM_OUTPUT_FRAMEBUFFER)) {
+        return -1;
+    }
+
     if (!fb_ready) { // Terminal has not been initalized, printing could(will?) cause a null pointer dereference
         return -1;
     }
 
+    if (back_buffer && view_offset != 0) { // jump back to the live screen when something is printed
+        view_offset = 0;
+        mark_all_stale();
+    }
+
     // Handle control characters
     switch (glyph) {
         case '\n':  // Move cursor to start of next line
@@ -71,12 +400,16 @@ static int putC(char glyph) {
             break;
 
         default: {  // Print Glyph, move cursor to right & wrap if neccesary
-            int glyph_offset = cursor_y * FONT_HEIGHT * fb_ppl + cursor_x * FONT_WIDTH;   // Calc offset for whole character
-
-            for (int y = 0; y < FONT_HEIGHT; y++) { // Loop through every pixel of the char and put on screen
-                for (int x = 0; x < FONT_WIDTH; x++) {
-                    fb[glyph_offset + y * fb_ppl + x] = (font[glyph][y] & (1 << x)) ? foreground_color : background_color;
+            if (back_buffer) {
+                cell_row(cursor_y, 0)[cursor_x] = (term_cell) { foreground_color, background_color, glyph };
+                if (!strip_stale[strip_index(cursor_y)]) { // a stale row gets redrawn from the cells anyways
+                    draw_glyph(&strip(cursor_y)[cursor_x * FONT_WIDTH], glyph, foreground_color, background_color);
+                    mark_dirty(cursor_x, cursor_y);
                 }
+                flush_pending = 1;
+            } else {
+                int glyph_offset = cursor_y * FONT_HEIGHT * fb_ppl + cursor_x * FONT_WIDTH;   // Calc offset for whole character
+                draw_glyph((uint32_t*) &fb[glyph_offset], glyph, foreground_color, background_color);
             }
 
             cursor_x++;
@@ -89,35 +422,60 @@ static int putC(char glyph) {
         cursor_y++;
     }
     if (cursor_y >= fb_height) {
-        cursor_y = 0;
+        if (back_buffer) {
+            scroll_up();
+            cursor_y = fb_height - 1;
+        } else { // without the back buffer there's nowhere to keep the text, so just start at the top again
+            cursor_y = 0;
+        }
     }
     return -1;
 }
 
 void term_write(char* string) {
+    spinlock_acquire(&term_lock);
     while(*string > 0) {
         putC(*string);
         string++;
     }
+    finish_write();
+    spinlock_release(&term_lock);
+}
+
+void term_writeBuffer(const char* data, uint64_t length) {
+    spinlock_acquire(&term_lock);
+    for(uint64_t i = 0; i < length; i++) {
+        putC(data[i]);
+    }
+    finish_write();
+    spinlock_release(&term_lock);
 }
 
 void term_writeHex(uint64_t hex, uint8_t width) {
+    spinlock_acquire(&term_lock);
     int digit;
     for(int i = (width-1)*4; i >= 0; i -= 4) { // loop through shifting less bits over
         digit = hex >> i & 0xf; // last 16 bits
         if(digit > 9) { digit+= 0x37; } else { digit += 0x30; } // offset to correct klscii character
         putC(digit);
     }
+    finish_write();
+    spinlock_release(&term_lock);
 }
 
 void term_writeNumber(int number) {
-    if(number < 0) {
-        putC('-');
-        number = -number;
-    }
-    int rest = number / 10;
-    if(rest > 0) {
-        term_writeNumber(rest);
-    }
-    putC(0x30 + (number % 10));
+    // digits come out backwards, so collect them first. going through unsigned means INT_MIN can be negated too
+    char digits[11];
+    int length = 0;
+    uint32_t magnitude = number < 0 ? -(uint32_t) number : (uint32_t) number;
+    do {
+        digits[length++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while(magnitude);
+
+    spinlock_acquire(&term_lock);
+    if(number < 0) putC('-');
+    while(length) putC(digits[--length]);
+    finish_write();
+    spinlock_release(&term_lock);
 }
@@ -18,6 +18,9 @@
 #define FONT_WIDTH 8
 #define FONT_HEIGHT 8
 
+// rows of scrollback kept in the back buffer
+#define TERM_HISTORY_ROWS 1024
+
 #define COLORS_WHITE        0xF0F0F0
 #define COLORS_ORANGE       0xF2B233
 #define COLORS_MAGENTA      0xE57FD8
@@ -38,17 +41,39 @@
 #define COLORS_PUREBLACK    0x000000
 #define COLORS_PUREWHITE    0xFFFFFF
 
+// where output goes, for term_setOutput
+#define TERM_OUTPUT_FRAMEBUFFER 1
+#define TERM_OUTPUT_SERIAL      2
+#define TERM_OUTPUT_BOTH        (TERM_OUTPUT_FRAMEBUFFER | TERM_OUTPUT_SERIAL)
+
 void term_init(volatile uint32_t* in_fb, int width, int height, int ppl);
+// mirror output to the serial port, or send it only there. without a serial port it all goes to the framebuffer
+void term_setOutput(int output);
+// bytes needed for the back buffer & scrollback (only valid after term_init)
+uint64_t term_backBufferSize();
+// draw into a RAM copy of the screen from now on, term_flush copies the changed rows to the framebuffer.
+// the terminal only scrolls (and keeps history) once it has a back buffer, before that it wraps to the top
+void term_setBackBuffer(void* buffer);
+// copies what changed in the back buffer to the framebuffer. klog_drain calls this, and anything that halts has to too.
+// writes flush by themselves until term_setFlushOnWrite(0), then only if nothing has flushed for a few ms
+void term_flush();
+// idle cpus that drain the log turn this off, so many lines of output cost one copy to the framebuffer
+void term_setFlushOnWrite(int enabled);
+// move the view back (positive) or forward (negative) through the history. printing jumps back to the bottom
+void term_scroll(int lines);
 
 void term_setCursorPos(int x, int y);
 void term_setTextColor(int color);
 void term_setBackgroundColor(int color);
 
 void term_write(char* string);
+// writes length characters (which can include 0s) as one batch
+void term_writeBuffer(const char* data, uint64_t length);
+// width is in hex digits
 void term_writeHex(uint64_t hex, uint8_t width);
 void term_writeNumber(int number);
 
-#define term_writeHex32(hex) term_writeHex(hex, 4)
-#define term_writeHex64(hex) term_writeHex(hex, 8)
+#define term_writeHex32(hex) term_writeHex(hex, 8)
+#define term_writeHex64(hex) term_writeHex(hex, 16)
 
 #endif
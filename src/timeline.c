@@ -0,0 +1,88 @@
+/* timeline.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "term.h"
+#include "kprintf.h"
+#include "clock.h"
+#include "serial.h"
+#include "timeline.h"
+
+static boot_timeline timeline;
+
+void timeline_init(boot_timeline* loader_timeline, uint64_t entry_tsc) {
+    timeline = *loader_timeline;
+    // the time between ExitBootServices and the kernel getting control, including the jump itself
+    if(timeline.phase_count < TIMELINE_MAX_PHASES) {
+        timeline_mark(&timeline, "handoff");
+        timeline.phases[timeline.phase_count - 1].end_tsc = entry_tsc;
+    }
+}
+
+void timeline_phase(const char* name) {
+    timeline_mark(&timeline, name);
+}
+
+static uint64_t phase_start(uint32_t index) {
+    return index ? timeline.phases[index - 1].end_tsc : timeline.start_tsc;
+}
+
+void timeline_print() {
+    term_write("boot timeline (us since loader entry, duration):\n");
+    for(uint32_t i = 0; i < timeline.phase_count; i++) {
+        uint64_t start = time_cyclesToNs(phase_start(i) - timeline.start_tsc) / 1000;
+        uint64_t duration = time_cyclesToNs(timeline.phases[i].end_tsc - phase_start(i)) / 1000;
+        kprintf("%9lu%9lu  %s\n", start, duration, timeline.phases[i].name);
+    }
+}
+
+static char json[TIMELINE_MAX_PHASES * 80 + 64];
+static uint64_t json_length;
+
+static void append(const char* string) {
+    while(*string && json_length < sizeof(json) - 1) {
+        json[json_length++] = *string++;
+    }
+}
+
+static void append_number(uint64_t number) {
+    char digits[20];
+    int count = 0;
+    do {
+        digits[count++] = '0' + number % 10;
+        number /= 10;
+    } while(number > 0);
+    while(count > 0 && json_length < sizeof(json) - 1) {
+        json[json_length++] = digits[--count];
+    }
+}
+
+void timeline_emit() {
+    if(!serial_present()) return;
+    json_length = 0;
+    append("BOOT_TIMELINE {\"tsc_hz\":");
+    append_number(clock_tscFrequency());
+    append(",\"phases\":[");
+    for(uint32_t i = 0; i < timeline.phase_count; i++) {
+        if(i > 0) append(",");
+        append("{\"name\":\"");
+        append(timeline.phases[i].name); // names are string literals in this repo, nothing needs escaping
+        append("\",\"start_ns\":");
+        append_number(time_cyclesToNs(phase_start(i) - timeline.start_tsc));
+        append(",\"duration_ns\":");
+        append_number(time_cyclesToNs(timeline.phases[i].end_tsc - phase_start(i)));
+        append("}");
+    }
+    append("]}\n");
+    serial_write(json, json_length);
+}
@@ -0,0 +1,69 @@
+/* timeline.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  boot timeline: TSC timestamps at the end of each boot phase, from loader entry to the end of kernel init.
+  the loader fills in the first part and passes it in loader_data, the kernel keeps adding to its own copy
+ */
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdint.h>
+
+#include "cpu.h"
+
+#define TIMELINE_MAX_PHASES 48
+#define TIMELINE_NAME_SIZE 24
+
+typedef struct {
+    char name[TIMELINE_NAME_SIZE];  // inline so loader_data doesn't point into memory the kernel reclaims
+    uint64_t end_tsc;               // each phase starts where the one before it ended
+} boot_phase;
+
+typedef struct {
+    uint64_t start_tsc;             // loader entry
+    uint32_t phase_count;
+    boot_phase phases[TIMELINE_MAX_PHASES];
+} boot_timeline;
+
+static inline void timeline_start(boot_timeline* timeline) {
+    timeline->start_tsc = cpu_readTsc();
+    timeline->phase_count = 0;
+}
+
+// ends the current phase, returns how many ticks it took. phases past TIMELINE_MAX_PHASES are dropped
+static inline uint64_t timeline_mark(boot_timeline* timeline, const char* name) {
+    uint64_t now = cpu_readTsc();
+    uint64_t previous = timeline->phase_count ? timeline->phases[timeline->phase_count - 1].end_tsc : timeline->start_tsc;
+    if(timeline->phase_count < TIMELINE_MAX_PHASES) {
+        boot_phase* phase = &timeline->phases[timeline->phase_count++];
+        int i = 0;
+        for(; i < TIMELINE_NAME_SIZE - 1 && name[i]; i++) {
+            phase->name[i] = name[i];
+        }
+        phase->name[i] = 0;
+        phase->end_tsc = now;
+    }
+    return now - previous;
+}
+
+// --- kernel side ---
+
+// continues the loader's timeline, entry_tsc is when the kernel got control
+void timeline_init(boot_timeline* loader_timeline, uint64_t entry_tsc);
+// ends the current kernel boot phase
+void timeline_phase(const char* name);
+// every phase with its start & duration. needs clock_init for the conversion to time
+void timeline_print();
+// the same as one line of JSON on the serial port, prefixed with "BOOT_TIMELINE " so scripts can grep for it
+void timeline_emit();
+
+#endif
@@ -14,6 +14,9 @@
 #include <stdint.h>
 
 #include "uefi_loader.h"
+#include "cpu.h"
+#include "mem.h"
+#include "lz4.h"
 
 #define EI_NIDENT 16
 typedef struct {
@@ -44,6 +47,23 @@ typedef struct {
     uint64_t    p_align;
 } elf_program_header;
 #define PT_LOAD 1
+#define PT_DYNAMIC 2
+
+typedef struct {
+    int64_t     d_tag;
+    uint64_t    d_val;
+} elf_dynamic;
+#define DT_NULL     0
+#define DT_RELA     7
+#define DT_RELASZ   8
+#define DT_RELAENT  9
+
+typedef struct {
+    uint64_t    r_offset;
+    uint64_t    r_info;
+    int64_t     r_addend;
+} elf_rela;
+#define R_X86_64_RELATIVE 8
 
 #define PRINTLN(message) ST->ConOut->OutputString(ST->ConOut, u"" message "\r\n")
 #define CHECK_EFI_ERROR(message) if(EFI_ERROR(status)) { show_error(ST, u"" message "\r\n"); return status; }
@@ -63,16 +83,65 @@ EFI_STATUS read_file(EFI_FILE_HANDLE file, uint64_t offset, uint64_t size, void*
     uint64_t read_bytes = 0;
     while(read_bytes < size) {
         remaining = size - read_bytes;
-        file->Read(file, &remaining, destination);
+        status = file->Read(file, &remaining, (uint8_t*) destination + read_bytes);
         if(EFI_ERROR(status)) return status;
+        if(remaining == 0) return EFI_END_OF_FILE; // the file is shorter than the headers say
         read_bytes += remaining;
     }
     return EFI_SUCCESS;
 }
 
+// --- timing ---
+static uint64_t tsc_per_us;
+
+// good enough to tell where the time goes, the kernel does proper calibration
+static void calibrate_tsc(EFI_SYSTEM_TABLE* ST) {
+    uint64_t start = cpu_readTsc();
+    ST->BootServices->Stall(1000);
+    tsc_per_us = (cpu_readTsc() - start) / 1000;
+    if(tsc_per_us == 0) tsc_per_us = 1;
+}
+
+static void print_number(EFI_SYSTEM_TABLE* ST, uint64_t number) {
+    uint16_t buffer[21];
+    int i = 20;
+    buffer[i] = 0;
+    do {
+        buffer[--i] = u'0' + number % 10;
+        number /= 10;
+    } while(number > 0);
+    ST->ConOut->OutputString(ST->ConOut, &buffer[i]);
+}
+
+// prints "<name>: <bytes> bytes in <reads> reads, <time> us", leaving out the parts that are 0
+static void print_phase(EFI_SYSTEM_TABLE* ST, uint16_t* name, uint64_t bytes, uint64_t reads, uint64_t ticks) {
+    ST->ConOut->OutputString(ST->ConOut, name);
+    ST->ConOut->OutputString(ST->ConOut, u": ");
+    if(bytes > 0) {
+        print_number(ST, bytes);
+        ST->ConOut->OutputString(ST->ConOut, u" bytes");
+        if(reads > 0) {
+            ST->ConOut->OutputString(ST->ConOut, u" in ");
+            print_number(ST, reads);
+            ST->ConOut->OutputString(ST->ConOut, u" reads");
+        }
+        ST->ConOut->OutputString(ST->ConOut, u", ");
+    }
+    print_number(ST, ticks / tsc_per_us);
+    ST->ConOut->OutputString(ST->ConOut, u" us\r\n");
+}
+
+// reads can join across a gap this big, it's faster to read a bit of padding than to make another request
+#define MAX_READ_GAP (64 * 1024)
+
 EFI_STATUS uefi_loader(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE* ST) {
     EFI_STATUS status;
+    boot_timeline timeline;
+    timeline_start(&timeline);
     PRINTLN("haiii :3");
+    mem_init();
+    calibrate_tsc(ST);
+    timeline_mark(&timeline, "loader init");
     
     // find and open kernel executable
     // TODO: store the device/partition to read the kerenel from somewhere (efi variables?) so the kernel file can be stored on our own data partition
@@ -93,11 +162,33 @@ EFI_STATUS uefi_loader(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE* ST) {
     EFI_FILE_HANDLE kernel_file;
     status = root_directory->Open(root_directory, &kernel_file, u"EFI\\BOOT\\kernelua", EFI_FILE_MODE_READ, 0);
     CHECK_EFI_ERROR("failed to open EFI/Boot/kernelua");
+    uint64_t open_ticks = timeline_mark(&timeline, "open");
 
     // load kernel image
     elf_header kernel_header;
     status = read_file(kernel_file, 0, sizeof(kernel_header), &kernel_header);
     CHECK_EFI_ERROR("failed to read elf header");
+
+    // the kernel file is either the elf file itself, or an lz4 container (see lz4.h) with the elf headers & compressed
+    // segments. a container is read in one go, its headers are copied out & the segments decompressed into place later
+    uint8_t* container = 0;
+    lz4_container_header container_header;
+    memcpy(&container_header, &kernel_header, sizeof(container_header));
+    uint64_t read_ticks = 0;
+    if(container_header.magic == LZ4_CONTAINER_MAGIC) {
+        uint64_t headers_offset = lz4_headersOffset(&container_header);
+        if(container_header.headers_size < sizeof(kernel_header) || headers_offset + container_header.headers_size > container_header.size) {
+            show_error(ST, u"corrupt kernel container!\r\n");
+            return EFI_COMPROMISED_DATA;
+        }
+        status = ST->BootServices->AllocatePool(EfiLoaderData, container_header.size, (void**) &container);
+        CHECK_EFI_ERROR("failed to allocate memory for the kernel container");
+        status = read_file(kernel_file, 0, container_header.size, container);
+        CHECK_EFI_ERROR("failed to read kernel container");
+        read_ticks = timeline_mark(&timeline, "read");
+        memcpy(&kernel_header, container + headers_offset, sizeof(kernel_header));
+    }
+
     if(kernel_header.e_ident[0] != 0x7f
       || kernel_header.e_ident[1] != 'E'
       || kernel_header.e_ident[2] != 'L'
@@ -110,8 +201,16 @@ EFI_STATUS uefi_loader(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE* ST) {
     uint64_t program_headers_size = kernel_header.e_phnum * kernel_header.e_phentsize;
     status = ST->BootServices->AllocatePool(EfiLoaderData, program_headers_size, (void**) &program_headers);
     CHECK_EFI_ERROR("failed to allocate memory for program headers");
-    status = read_file(kernel_file, kernel_header.e_phoff, program_headers_size, program_headers);
-    CHECK_EFI_ERROR("failed to read program headers");
+    if(container) {
+        if(kernel_header.e_phoff + program_headers_size > container_header.headers_size) {
+            show_error(ST, u"corrupt kernel container!\r\n");
+            return EFI_COMPROMISED_DATA;
+        }
+        memcpy(program_headers, container + lz4_headersOffset(&container_header) + kernel_header.e_phoff, program_headers_size);
+    } else {
+        status = read_file(kernel_file, kernel_header.e_phoff, program_headers_size, program_headers);
+        CHECK_EFI_ERROR("failed to read program headers");
+    }
 
     uint64_t image_begin = -1;
     uint64_t image_end = 0;
@@ -132,25 +231,155 @@ EFI_STATUS uefi_loader(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE* ST) {
         }
     }
 
+    uint64_t header_ticks = timeline_mark(&timeline, "headers");
+
     uint64_t image_page_count = (image_end - image_begin) / 4096;
     uint64_t load_address;
     status = ST->BootServices->AllocatePages(AllocateAnyPages, KERNEL_MEMORY_TYPE, image_page_count, &load_address);
     CHECK_EFI_ERROR("failed to allocate memory to load program segments");
 
-    // zero out memory just in case the firmware doesn't (would break the kernel probably)
-    uint8_t* buf = (uint8_t*) load_address;
-    for(uint64_t i = 0; i < (image_end - image_begin); i++) {
-        buf[i] = 0;
+    // sort the segments by file offset (there's only a handful, insertion sort is fine)
+    for(int i = 1; i < kernel_header.e_phnum; i++) {
+        elf_program_header program_header = program_headers[i];
+        int j = i - 1;
+        for(; j >= 0 && program_headers[j].p_offset > program_header.p_offset; j--) {
+            program_headers[j + 1] = program_headers[j];
+        }
+        program_headers[j + 1] = program_header;
+    }
+
+    timeline_mark(&timeline, "allocate image");
+
+    uint64_t segment_bytes = 0;
+    uint64_t segment_reads = 0;
+    if(container) {
+        // each block goes straight into the segment's pages, the blocks follow the elf headers
+        lz4_container_segment* segments = (lz4_container_segment*) (container + sizeof(lz4_container_header));
+        uint64_t block_offset = lz4_headersOffset(&container_header) + container_header.headers_size;
+        for(uint32_t i = 0; i < container_header.segment_count; i++) {
+            lz4_container_segment segment = segments[i];
+            if(segment.vaddr < image_begin || segment.vaddr + segment.size > image_end
+              || block_offset + segment.compressed_size > container_header.size
+              || lz4_decompress(container + block_offset, segment.compressed_size,
+                    (uint8_t*) (load_address + segment.vaddr - image_begin), segment.size) != (int64_t) segment.size) {
+                show_error(ST, u"corrupt kernel segment!\r\n");
+                return EFI_COMPROMISED_DATA;
+            }
+            block_offset += segment.compressed_size;
+            segment_bytes += segment.size;
+        }
+        ST->BootServices->FreePool(container);
+    } else {
+        // read the segments in file order. neighbouring segments that are laid out in memory exactly like
+        // in the file are joined into one read, the bytes between them are padding
+        uint64_t run_offset = 0;
+        uint64_t run_address = 0;
+        uint64_t run_size = 0;
+        for(int i = 0; i <= kernel_header.e_phnum; i++) {
+            int last = i == kernel_header.e_phnum;
+            elf_program_header program_header;
+            uint64_t segment_address = 0;
+            if(!last) {
+                program_header = program_headers[i];
+                if(program_header.p_type != PT_LOAD || program_header.p_filesz == 0) continue;
+                segment_address = load_address + program_header.p_vaddr - image_begin;
+
+                uint64_t run_end = run_offset + run_size;
+                if(run_size > 0 && program_header.p_offset >= run_end
+                  && program_header.p_offset - run_end <= MAX_READ_GAP
+                  && program_header.p_offset - run_offset == segment_address - run_address) {
+                    run_size = program_header.p_offset + program_header.p_filesz - run_offset;
+                    continue;
+                }
+            }
+
+            if(run_size > 0) {
+                status = read_file(kernel_file, run_offset, run_size, (void*) run_address);
+                CHECK_EFI_ERROR("failed to read program segment");
+                segment_bytes += run_size;
+                segment_reads++;
+            }
+            if(!last) {
+                run_offset = program_header.p_offset;
+                run_address = segment_address;
+                run_size = program_header.p_filesz;
+            }
+        }
     }
+    uint64_t segment_ticks = timeline_mark(&timeline, container ? "decompress" : "segments");
 
+    // only the part of each segment that isn't in the file (.bss) needs zeroing.
+    // this is done after all the reads since a joined read might have put padding there
+    uint64_t zeroed_bytes = 0;
     for(int i = 0; i < kernel_header.e_phnum; i++) {
         elf_program_header program_header = program_headers[i];
-        if(program_header.p_type != PT_LOAD) continue;
+        if(program_header.p_type != PT_LOAD || program_header.p_memsz <= program_header.p_filesz) continue;
 
         uint64_t segment_address = load_address + program_header.p_vaddr - image_begin;
-        status = read_file(kernel_file, program_header.p_offset, program_header.p_filesz, (void*) segment_address);
-        CHECK_EFI_ERROR("failed to read program segment");
+        memzero((void*) (segment_address + program_header.p_filesz), program_header.p_memsz - program_header.p_filesz);
+        zeroed_bytes += program_header.p_memsz - program_header.p_filesz;
+    }
+    uint64_t zero_ticks = timeline_mark(&timeline, "bss");
+
+    // a static-pie only has relative relocations, for pointers in its data (like tables of function pointers)
+    uint64_t relocation_count = 0;
+    for(int i = 0; i < kernel_header.e_phnum; i++) {
+        if(program_headers[i].p_type != PT_DYNAMIC) continue;
+        uint64_t rela = 0, rela_size = 0, rela_entry = sizeof(elf_rela);
+        for(elf_dynamic* dynamic = (elf_dynamic*) (load_address + program_headers[i].p_vaddr - image_begin); dynamic->d_tag != DT_NULL; dynamic++) {
+            if(dynamic->d_tag == DT_RELA) rela = dynamic->d_val;
+            else if(dynamic->d_tag == DT_RELASZ) rela_size = dynamic->d_val;
+            else if(dynamic->d_tag == DT_RELAENT) rela_entry = dynamic->d_val;
+        }
+        for(uint64_t offset = 0; rela && offset < rela_size; offset += rela_entry) {
+            elf_rela* relocation = (elf_rela*) (load_address + rela + offset - image_begin);
+            if((relocation->r_info & 0xffffffff) != R_X86_64_RELATIVE) {
+                show_error(ST, u"unsupported relocation type in kernel!\r\n");
+                return EFI_UNSUPPORTED;
+            }
+            *(uint64_t*) (load_address + relocation->r_offset - image_begin) = load_address + relocation->r_addend - image_begin;
+            relocation_count++;
+        }
+    }
+    uint64_t relocation_ticks = timeline_mark(&timeline, "relocations");
+
+    // the initrd is optional. it's read in one go, straight into memory the kernel keeps
+    void* initrd = 0;
+    uint64_t initrd_size = 0;
+    EFI_FILE_HANDLE initrd_file;
+    status = root_directory->Open(root_directory, &initrd_file, u"EFI\\BOOT\\initrd.tar", EFI_FILE_MODE_READ, 0);
+    if(!EFI_ERROR(status)) {
+        // room for the file name after the fixed part
+        uint64_t file_info[64];
+        uint64_t file_info_size = sizeof(file_info);
+        EFI_GUID file_info_guid = EFI_FILE_INFO_ID;
+        status = initrd_file->GetInfo(initrd_file, &file_info_guid, &file_info_size, file_info);
+        CHECK_EFI_ERROR("failed to get the size of EFI/BOOT/initrd.tar");
+        initrd_size = ((EFI_FILE_INFO*) file_info)->FileSize;
+
+        uint64_t initrd_address;
+        status = ST->BootServices->AllocatePages(AllocateAnyPages, KERNEL_MEMORY_TYPE, (initrd_size + 4095) / 4096, &initrd_address);
+        CHECK_EFI_ERROR("failed to allocate memory for the initrd");
+        status = read_file(initrd_file, 0, initrd_size, (void*) initrd_address);
+        CHECK_EFI_ERROR("failed to read EFI/BOOT/initrd.tar");
+        initrd_file->Close(initrd_file);
+        initrd = (void*) initrd_address;
     }
+    uint64_t initrd_ticks = timeline_mark(&timeline, "initrd");
+
+    print_phase(ST, u"open", 0, 0, open_ticks);
+    if(container) {
+        print_phase(ST, u"read", container_header.size, 1, read_ticks);
+        print_phase(ST, u"headers", sizeof(kernel_header) + program_headers_size, 0, header_ticks);
+        print_phase(ST, u"decompress", segment_bytes, 0, segment_ticks);
+    } else {
+        print_phase(ST, u"headers", sizeof(kernel_header) + program_headers_size, 2, header_ticks);
+        print_phase(ST, u"segments", segment_bytes, segment_reads, segment_ticks);
+    }
+    print_phase(ST, u"bss", zeroed_bytes, 0, zero_ticks);
+    if(relocation_count) print_phase(ST, u"relocations", relocation_count * sizeof(elf_rela), 0, relocation_ticks);
+    if(initrd) print_phase(ST, u"initrd", initrd_size, 1, initrd_ticks);
+    timeline_mark(&timeline, "print");
 
     // kernel start function (uses the unix/C standard calling convention; NOT the UEFI one that this program is compiled to use)
     entrypoint_t* uefi_start = (entrypoint_t*) (load_address + kernel_header.e_entry - image_begin);
@@ -177,9 +406,21 @@ EFI_STATUS uefi_loader(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE* ST) {
       show_error(ST, u"could not find a 1920x1080 graphics mode\r\n");
       return EFI_UNSUPPORTED;
     }
+    timeline_mark(&timeline, "gop query");
 
     status = graphics->SetMode(graphics, selectedMode);
     CHECK_EFI_ERROR("failed to set graphics mode");
+    timeline_mark(&timeline, "gop set");
+
+    // find the ACPI tables, so the kernel can find the other cpus
+    void* acpi_rsdp = 0;
+    EFI_GUID acpi_20_guid = ACPI_20_TABLE_GUID;
+    for(uint64_t i = 0; i < ST->NumberOfTableEntries; i++) {
+        if(memcmp(&ST->ConfigurationTable[i].VendorGuid, &acpi_20_guid, sizeof(EFI_GUID)) == 0) {
+            acpi_rsdp = ST->ConfigurationTable[i].VendorTable;
+            break;
+        }
+    }
 
     // get memory map
     EFI_MEMORY_DESCRIPTOR* memory_map;
@@ -204,9 +445,11 @@ EFI_STATUS uefi_loader(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE* ST) {
         // allocating memory for the next memory map might increase the size of the map. double the requested size to ensure we have enough space
         memory_map_size *= 2;
     }
+    timeline_mark(&timeline, "memory map");
 
     status = ST->BootServices->ExitBootServices(ImageHandle, memory_map_key);
     CHECK_EFI_ERROR("failed to exit boot services");
+    timeline_mark(&timeline, "exit boot services");
 
     loader_data data;
     data.framebuffer = (uint32_t*) graphics->Mode->FrameBufferBase;
@@ -217,6 +460,10 @@ EFI_STATUS uefi_loader(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE* ST) {
     data.memory_map_size = memory_map_size;
     data.memory_descriptor_size = memory_descriptor_size;
     data.debug_base_address = load_address;
+    data.acpi_rsdp = acpi_rsdp;
+    data.initrd = initrd;
+    data.initrd_size = initrd_size;
+    data.timeline = timeline;
 
     (*uefi_start)(&data);
     while(1);
@@ -17,6 +17,8 @@
 
 #include <stdint.h>
 
+#include "timeline.h"
+
 typedef struct {
     uint32_t* framebuffer;
     uint32_t  framebuffer_width;
@@ -26,6 +28,10 @@ typedef struct {
     uint64_t  memory_map_size;
     uint64_t  memory_descriptor_size;
     uint64_t  debug_base_address;
+    void*     acpi_rsdp;    // ACPI 2.0+ root pointer from the firmware's configuration table, or 0
+    void*     initrd;       // the tar archive from EFI/BOOT/initrd.tar in KERNEL_MEMORY_TYPE pages, or 0 if there isn't one
+    uint64_t  initrd_size;
+    boot_timeline timeline; // the loader's phases, up to ExitBootServices
 } loader_data;
 
 // allocate program segments with this memory type so the kernel knows where it is (and therefore where it isn't)
@@ -13,26 +13,275 @@
 #include <stdint.h>
 
 #include "uefi_loader.h"
+#include "cpu.h"
+#include "mem.h"
 #include "term.h"
+#include "kprintf.h"
+#include "klog.h"
+#include "clock.h"
+#include "acpi.h"
+#include "apic.h"
+#include "percpu.h"
+#include "sched.h"
+#include "task.h"
+#include "smp.h"
+#include "serial.h"
+#include "interrupts.h"
+#include "timeline.h"
 #include "memory_manager.h"
+#include "vm.h"
+#include "phys.h"
+#include "initrd.h"
+#ifdef KERNEL_LUA
+#include "script.h"
+#endif
+
+#ifdef BOOT_TESTS
+// spreads some page allocations over every cpu, to check that the scheduler actually uses them
+// (and to warm up the page caches)
+#define TEST_TASK_COUNT 64
+#define TEST_TASK_PAGES 48
+static void test_task(void* argument) {
+    void* pages[TEST_TASK_PAGES];
+    for(int round = 0; round < 64; round++) {
+        for(int i = 0; i < TEST_TASK_PAGES; i++) pages[i] = memory_allocatePage();
+        for(int i = 0; i < TEST_TASK_PAGES; i++) memory_freePages(pages[i]);
+    }
+    *(uint32_t*) argument = cpu_current()->index;
+}
+
+static void test_scheduler() {
+    sched_group group = { 0 };
+    sched_task tasks[TEST_TASK_COUNT];
+    uint32_t ran_on[TEST_TASK_COUNT];
+    uint64_t start = cycles_now();
+    for(int i = 0; i < TEST_TASK_COUNT; i++) {
+        tasks[i] = (sched_task) { test_task, &ran_on[i], 0 };
+        sched_spawn(&group, &tasks[i]);
+    }
+    sched_wait(&group);
+    uint64_t elapsed = time_cyclesToNs(cycles_now() - start);
+
+    uint8_t used[APIC_MAX_CPUS] = { 0 };
+    int cpus_used = 0;
+    for(int i = 0; i < TEST_TASK_COUNT; i++) {
+        if(!used[ran_on[i]]) cpus_used++;
+        used[ran_on[i]] = 1;
+    }
+    kprintf("scheduler: %d tasks on %d cpus in %lu us\npage caches:\n", TEST_TASK_COUNT, cpus_used, elapsed / 1000);
+    memory_printCacheStats();
+}
+
+// 1 GiB of address space, but only the pages that are touched get memory
+static void test_reservation() {
+    uint8_t* area = memory_reserve(1 << 30, MEMORY_CACHE_WRITE_BACK);
+    for(int i = 0; i < 16; i++) {
+        area[(uint64_t) i << 26] = i;
+    }
+    kprintf("reserved 1 GiB, %lu pages committed\n", memory_committedPages());
+}
+
+// maps a page only another address space can see, and times switching back and forth
+#define TEST_SPACE_ADDRESS 0x0000008000000000 // 512 GiB, the second top-level entry
+static void test_address_space() {
+    vm_space* space = vm_createSpace();
+    void* page = memory_allocatePage();
+    if(!space || !page || !vm_map(space, TEST_SPACE_ADDRESS, virt_to_phys(page), 4096, VM_WRITABLE | VM_NO_EXECUTE, MEMORY_CACHE_WRITE_BACK)) {
+        term_write("couldn't create an address space\n");
+        return;
+    }
+    vm_switch(space);
+    *(volatile uint64_t*) TEST_SPACE_ADDRESS = 0x5eed;
+    vm_switch(vm_kernelSpace());
+    int visible = *(volatile uint64_t*) page == 0x5eed;
+
+    uint64_t start = cycles_now();
+    for(int i = 0; i < 1000; i++) {
+        vm_switch(space);
+        (void) *(volatile uint64_t*) TEST_SPACE_ADDRESS;
+        vm_switch(vm_kernelSpace());
+    }
+    uint64_t elapsed = time_cyclesToNs(cycles_now() - start);
+    vm_unmap(space, TEST_SPACE_ADDRESS, 4096);
+    memory_freePages(page);
+
+    kprintf("%s pcid %lu, %lu ns per switch\n", visible ? "address space:" : "address space mapping broken!",
+        space->cr3 & 0xfff, elapsed / 2000);
+}
+
+// times the writer side of the log. the records are debug level, so they only show up in klog_dump
+#define TEST_KLOG_RECORDS 128
+static void test_klog() {
+    uint64_t start = cycles_now();
+    for(int i = 0; i < TEST_KLOG_RECORDS; i++) {
+        klog_write(KLOG_DEBUG, "klog test record", 16);
+    }
+    uint64_t middle = cycles_now();
+    for(int i = 0; i < TEST_KLOG_RECORDS; i++) {
+        klog(KLOG_DEBUG, "klog test record %d of %d", i, TEST_KLOG_RECORDS);
+    }
+    uint64_t end = cycles_now();
+    klog(KLOG_INFO, "klog: %lu ns per klog_write, %lu ns per formatted klog",
+        time_cyclesToNs(middle - start) / TEST_KLOG_RECORDS, time_cyclesToNs(end - middle) / TEST_KLOG_RECORDS);
+}
+#endif
+
+// two tasks taking turns: each wakes the other and suspends, so every round is two switches
+#define TEST_SWITCH_ROUNDS 10000
+typedef struct {
+    task* ping;
+    task* pong;
+    task* waiter;
+    uint64_t cycles;
+} switch_test;
+
+static void test_pong(void* argument) {
+    switch_test* test = argument;
+    // ping couldn't be created, let test_tasks return without leaving this task behind
+    if(!test->ping) {
+        task_wake(test->waiter);
+        return;
+    }
+    for(int i = 0; i < TEST_SWITCH_ROUNDS; i++) {
+        task_suspend();
+        task_wake(test->ping);
+    }
+}
+
+static void test_ping(void* argument) {
+    switch_test* test = argument;
+    uint64_t start = cycles_now();
+    for(int i = 0; i < TEST_SWITCH_ROUNDS; i++) {
+        task_wake(test->pong);
+        task_suspend();
+    }
+    test->cycles = cycles_now() - start;
+    task_wake(test->waiter);
+}
+
+static void test_tasks() {
+    switch_test test = { 0 };
+    test.waiter = task_current();
+    test.pong = task_create(test_pong, &test);
+    if(!test.pong) {
+        term_write("couldn't create the switch test tasks\n");
+        return;
+    }
+    test.ping = task_create(test_ping, &test);
+    if(!test.ping) {
+        term_write("couldn't create the switch test tasks\n");
+        // pong is already queued and points at this frame, wait for it to exit
+        task_suspend();
+        return;
+    }
+    // they only start running once this suspends
+    task_suspend();
+    uint64_t switches = TEST_SWITCH_ROUNDS * 2;
+    kprintf("tasks: %lu cycles (%lu ns) per switch\n", test.cycles / switches, time_cyclesToNs(test.cycles) / switches);
+}
+
+// the rest of the boot cpu's life, on a stack of its own so the loader's memory (its stack included) can be freed
+static void boot_idle(void* argument) {
+    (void) argument;
+    uint64_t pages = memory_reclaimLoaderMemory();
+    kprintf("reclaimed %lu KiB of loader memory\n", pages * 4);
+    while(1) {
+        klog_drain();
+        asm("hlt");
+    }
+}
 
 entrypoint_t uefi_start;
 void uefi_start(loader_data* loader_data) {
+    uint64_t entry_tsc = cpu_readTsc();
+    asm("cli");
+    cpu_enableAvx();
+    mem_init();
+    timeline_init(&loader_data->timeline, entry_tsc);
+    klog_init(entry_tsc);
+    timeline_phase("cpu features");
+    percpu_initBsp();
+    timeline_phase("gdt");
+
     term_init(loader_data->framebuffer, loader_data->framebuffer_width, loader_data->framebuffer_height, loader_data->framebuffer_pixels_per_line);
+    if(serial_init()) {
+        term_setOutput(TERM_DEFAULT_OUTPUT);
+    }
+    interrupts_init();
+    timeline_phase("console & idt");
     term_write("hiii :3\n");
-    term_write("base address: 0x");
-    term_writeHex64(loader_data->debug_base_address);
-    term_write("\nframebuffer address: 0x");
-    term_writeHex64((uint64_t) loader_data->framebuffer);
-    term_write("\n");
+    kprintf("base address: 0x%lx\nframebuffer address: %p\nmem functions: %s\n",
+        loader_data->debug_base_address, (void*) loader_data->framebuffer, mem_variantName());
 
+#ifdef DEBUG
+    // wait here until a debugger sets pause to 0
+    term_flush();
     volatile int pause = 1;
     while(pause);
 
     term_write("woah unpaused\n");
+#endif
+
+    timeline_phase("banner");
+    clock_init();
+    timeline_phase("clock");
+    kprintf("tsc: %lu MHz, %s\n", clock_tscFrequency() / 1000000, clock_tscInvariant() ? "invariant" : "not invariant");
 
     memory_init(loader_data);
     term_write("memory init complete\n");
+    timeline_phase("memory stats");
+
+    uint64_t back_buffer_pages = (term_backBufferSize() + 4095) / 4096;
+    void* back_buffer = memory_allocatePages(back_buffer_pages);
+    if(back_buffer) {
+        term_setBackBuffer(back_buffer);
+        term_write("terminal back buffer enabled\n");
+    }
+    timeline_phase("back buffer");
+
+    if(initrd_init(loader_data->initrd, loader_data->initrd_size)) {
+        kprintf("initrd: %lu files in %lu KiB\n", initrd_fileCount(), loader_data->initrd_size / 1024);
+        const initrd_file* motd = initrd_find("motd.txt");
+        if(motd) term_writeBuffer((const char*) motd->data, motd->size);
+    }
+    timeline_phase("initrd");
+
+    if(!acpi_init(loader_data->acpi_rsdp)) {
+        term_write("no ACPI tables\n");
+    }
+    timeline_phase("acpi");
+    smp_init();
+    timeline_phase("smp");
+    serial_enableInterrupts();
+    asm("sti");
+    term_write("interrupts on\n");
+#ifdef BOOT_TESTS
+    // these leave things behind (the reservation can't be given back) and add a lot to the timeline
+    test_reservation();
+    timeline_phase("reservation test");
+    test_address_space();
+    timeline_phase("address space test");
+    test_scheduler();
+    timeline_phase("scheduler test");
+    test_klog();
+    timeline_phase("klog test");
+#endif
+    test_tasks();
+    timeline_phase("task switch test");
+
+#ifdef KERNEL_LUA
+    script_runBoot();
+    timeline_phase("lua boot");
+#endif
+
+    timeline_print();
+    timeline_emit();
 
-    while(1);
+    // the boot task is never woken, so nothing runs on the loader's stack (or looks at loader_data) after this
+    if(task_create(boot_idle, 0)) task_suspend();
+    // without that task the loader's memory stays in use
+    while(1) {
+        klog_drain();
+        asm("hlt");
+    }
 }
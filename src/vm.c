@@ -0,0 +1,162 @@
+/* vm.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+ */
+
+#include <stdint.h>
+
+#include "cpu.h"
+#include "mem.h"
+#include "phys.h"
+#include "heap.h"
+#include "percpu.h"
+#include "spinlock.h"
+#include "vm.h"
+
+#define CR3_NO_FLUSH (1ull << 63)   // keep the TLB entries of the PCID being loaded
+#define CR3_PCID_MASK 0xfff
+#define MAX_PCID 4096
+
+// flushing a few pages one at a time is cheaper than losing every other TLB entry of the space
+#define INVLPG_LIMIT 32
+
+static vm_space kernel_space;
+static int has_pcid;
+static int has_invpcid;
+static int has_nx;
+static uint32_t next_pcid = 1;  // PCID 0 is the kernel's
+
+void vm_init() {
+    has_pcid = (cpu_cpuid(1, 0).ecx & CPUID_1_ECX_PCID) != 0;
+    has_invpcid = has_pcid && cpu_maxLeaf(0) >= 7 && (cpu_cpuid(7, 0).ebx & CPUID_7_EBX_INVPCID) != 0;
+    has_nx = cpu_maxLeaf(0x80000000) >= 0x80000001
+        && (cpu_cpuid(0x80000001, 0).edx & CPUID_80000001_EDX_NX) != 0;
+    kernel_space.pml4 = memory_pageMap();
+    kernel_space.cr3 = virt_to_phys(kernel_space.pml4);
+    vm_initCpu();
+}
+
+void vm_initCpu() {
+    if(has_nx) cpu_writeMsr(MSR_IA32_EFER, cpu_readMsr(MSR_IA32_EFER) | EFER_NXE);
+    if(has_pcid) { // can only be turned on while the loaded cr3 has PCID 0, which the kernel's page map does
+        uint64_t cr4;
+        asm volatile("mov %%cr4, %0" : "=r"(cr4));
+        asm volatile("mov %0, %%cr4" : : "r"(cr4 | CR4_PCIDE));
+    }
+}
+
+vm_space* vm_kernelSpace() {
+    return &kernel_space;
+}
+
+vm_space* vm_createSpace() {
+    vm_space* space = kmalloc(sizeof(vm_space));
+    void* pml4 = memory_allocatePage();
+    if(!space || !pml4) {
+        if(space) kfree(space);
+        if(pml4) memory_freePages(pml4);
+        return 0;
+    }
+
+    spinlock_acquire(&memory_lock);
+    uint32_t pcid = has_pcid ? next_pcid : 0;
+    if(pcid < MAX_PCID) {
+        if(has_pcid) next_pcid++;
+        memcpy(pml4, kernel_space.pml4, PAGE_SIZE);
+    }
+    spinlock_release(&memory_lock);
+    if(pcid >= MAX_PCID) {
+        kfree(space);
+        memory_freePages(pml4);
+        return 0;
+    }
+
+    space->pml4 = pml4;
+    space->cr3 = virt_to_phys(pml4) | pcid;
+    space->stale_cpus = 0;
+    return space;
+}
+
+void vm_switch(vm_space* space) {
+    uint64_t cr3 = space->cr3;
+    if(has_pcid) {
+        uint64_t cpu_bit = 1ull << cpu_current()->index;
+        if(!(__atomic_fetch_and(&space->stale_cpus, ~cpu_bit, __ATOMIC_ACQ_REL) & cpu_bit)) {
+            cr3 |= CR3_NO_FLUSH;
+        }
+    }
+    cpu_writeCr3(cr3);
+}
+
+// whether any of the range is in a top-level entry that space got from the kernel's page map
+static int shares_kernel_table(vm_space* space, uint64_t virtual, uint64_t size) {
+    if(space == &kernel_space) return 0;
+    for(uint64_t i = (virtual >> 39) & 0x1ff; i <= ((virtual + size - 1) >> 39 & 0x1ff); i++) {
+        if((space->pml4[i] & PAGE_PRESENT) && space->pml4[i] == kernel_space.pml4[i]) return 1;
+    }
+    return 0;
+}
+
+// drops the TLB entries for a range that changed
+static void invalidate(vm_space* space, uint64_t virtual, uint64_t size) {
+    uint64_t pages = size / PAGE_SIZE;
+    uint64_t pcid = space->cr3 & CR3_PCID_MASK;
+    int current = (cpu_readCr3() & PAGE_ADDRESS_MASK) == (space->cr3 & PAGE_ADDRESS_MASK);
+    uint64_t cpu_bit = 1ull << cpu_current()->index;
+    // the other cpus catch up the next time they switch to this space
+    if(has_pcid) __atomic_fetch_or(&space->stale_cpus, ~cpu_bit, __ATOMIC_RELEASE);
+
+    if(pages <= INVLPG_LIMIT) {
+        if(current) {
+            for(uint64_t i = 0; i < pages; i++) cpu_invlpg(virtual + i * PAGE_SIZE);
+            return;
+        }
+        if(has_invpcid) {
+            for(uint64_t i = 0; i < pages; i++) cpu_invpcid(INVPCID_ADDRESS, pcid, virtual + i * PAGE_SIZE);
+            return;
+        }
+    } else if(has_invpcid) {
+        cpu_invpcid(INVPCID_SINGLE_CONTEXT, pcid, 0);
+        return;
+    }
+    if(current) {
+        cpu_writeCr3(space->cr3); // without CR3_NO_FLUSH, so this PCID's entries are dropped
+    } else if(has_pcid) {
+        __atomic_fetch_or(&space->stale_cpus, cpu_bit, __ATOMIC_RELEASE);
+    } // without PCIDs, a space that isn't loaded has nothing in the TLB
+}
+
+int vm_map(vm_space* space, uint64_t virtual, uint64_t physical, uint64_t size, uint64_t flags, memory_cache_type cache_type) {
+    if(!has_nx) flags &= ~VM_NO_EXECUTE;
+    spinlock_acquire(&memory_lock);
+    int allowed = !shares_kernel_table(space, virtual, size);
+    if(allowed) paging_map(space->pml4, virtual, physical, size, flags, cache_type);
+    spinlock_release(&memory_lock);
+    // mapping over something that wasn't there needs no flush, but whatever was there before might have been
+    if(allowed) invalidate(space, virtual, size);
+    return allowed;
+}
+
+uint64_t vm_unmap(vm_space* space, uint64_t virtual, uint64_t size) {
+    spinlock_acquire(&memory_lock);
+    uint64_t pages = shares_kernel_table(space, virtual, size) ? 0 : paging_unmap(space->pml4, virtual, size);
+    spinlock_release(&memory_lock);
+    if(pages) invalidate(space, virtual, size);
+    return pages;
+}
+
+uint64_t vm_protect(vm_space* space, uint64_t virtual, uint64_t size, uint64_t flags) {
+    if(!has_nx) flags &= ~VM_NO_EXECUTE;
+    spinlock_acquire(&memory_lock);
+    uint64_t pages = shares_kernel_table(space, virtual, size) ? 0 : paging_protect(space->pml4, virtual, size, flags);
+    spinlock_release(&memory_lock);
+    if(pages) invalidate(space, virtual, size);
+    return pages;
+}
@@ -0,0 +1,58 @@
+/* vm.h © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  address spaces: mapping, unmapping & protecting ranges of pages, and switching between spaces.
+  each space gets its own PCID (when the cpu has them) so switching doesn't flush the TLB,
+  and changes only invalidate the pages they touched.
+  TLB invalidation is only done on this cpu, there are no shootdowns to other cpus yet.
+ */
+
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+
+#include "paging.h"
+#include "memory_manager.h"
+
+typedef struct {
+    uint64_t* pml4;
+    uint64_t cr3;                   // physical address of the pml4 | PCID
+    volatile uint64_t stale_cpus;   // cpus that must flush this PCID the next time they switch to it
+} vm_space;
+
+// flags for vm_map & vm_protect
+#define VM_WRITABLE     PAGE_WRITABLE
+#define VM_USER         PAGE_USER
+#define VM_NO_EXECUTE   PAGE_NO_EXECUTE // ignored if the cpu doesn't support it
+
+// wraps the kernel's page map & turns on PCIDs & no-execute, once memory_init has loaded it
+void vm_init();
+// turns on PCIDs & no-execute on another cpu
+void vm_initCpu();
+
+vm_space* vm_kernelSpace();
+// a new space shares all of the kernel's top-level entries (ones added later for reservations are picked up on first touch),
+// everything else starts unmapped.
+// returns 0 if out of memory or PCIDs
+vm_space* vm_createSpace();
+// loads space on this cpu. with PCIDs, the TLB entries of the space that was loaded before are kept
+void vm_switch(vm_space* space);
+
+// all of these take page aligned ranges, and flush what they changed from this cpu's TLB.
+// returns 0 if the range is in a top-level entry shared with the kernel (and space isn't the kernel's)
+int vm_map(vm_space* space, uint64_t virtual, uint64_t physical, uint64_t size, uint64_t flags, memory_cache_type cache_type);
+// the frames are left to whoever allocated them. returns how many pages were mapped in the range
+uint64_t vm_unmap(vm_space* space, uint64_t virtual, uint64_t size);
+// returns how many pages were mapped in the range
+uint64_t vm_protect(vm_space* space, uint64_t virtual, uint64_t size, uint64_t flags);
+
+#endif
@@ -0,0 +1,35 @@
+/* font_masks.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  build tool: prints src/font_masks.h, which turns a row of a font.h glyph into a mask for each of its 8 pixels.
+  term.c blends the foreground & background colors with these, a whole row at a time
+ */
+
+#include <stdio.h>
+
+#include "../src/term.h"
+
+int main() {
+    printf("// THIS FILE IS GENERATED BY tools/font_masks.c, DO NOT EDIT MANUALLY, CHANGES WILL BE LOST\n");
+    printf("#ifndef FONT_MASKS_H\n#define FONT_MASKS_H\n\n");
+    printf("// indexed by a row of a glyph, pixel x is all ones if bit x is set (bits are columns right-to-left)\n");
+    printf("__attribute__((aligned(32)))\n");
+    printf("static const uint32_t font_row_masks[256][%d] = {\n", FONT_WIDTH);
+    for(int row = 0; row < 256; row++) {
+        printf("    {");
+        for(int x = 0; x < FONT_WIDTH; x++) {
+            printf(" 0x%08x%s", (row >> x) & 1 ? 0xffffffff : 0, x < FONT_WIDTH - 1 ? "," : " ");
+        }
+        printf("},\n");
+    }
+    printf("};\n\n#endif\n");
+    return 0;
+}
@@ -0,0 +1,179 @@
+/* lz4pack.c © Penguin_Spy 2025
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at https://mozilla.org/MPL/2.0/.
+ * This Source Code Form is "Incompatible With Secondary Licenses", as
+ * defined by the Mozilla Public License, v. 2.0.
+ *
+ * The Covered Software may not be used as training or other input data
+ * for LLMs, generative AI, or other forms of machine learning or neural
+ * networks.
+
+  build tool: packs kernelua.elf into the lz4 container the loader reads (see src/lz4.h).
+  each loadable segment is compressed separately, so the loader can decompress it straight into place.
+  every block is decompressed again & compared before it's written, a broken image fails the build instead of the boot
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/lz4.h"
+
+#define PT_LOAD 1
+
+// the parts of the elf header & program headers this needs
+typedef struct {
+    uint8_t  e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} elf_header;
+
+typedef struct {
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+} elf_program_header;
+
+#define HASH_BITS 16
+// the format's rules for the end of a block: the last match starts at least 12 bytes before the end,
+// and the last 5 bytes are always literals
+#define MATCH_START_LIMIT 12
+#define LAST_LITERALS 5
+
+static uint32_t read32(const uint8_t* bytes) {
+    uint32_t value;
+    memcpy(&value, bytes, 4);
+    return value;
+}
+
+static uint32_t hash32(uint32_t value) {
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static uint8_t* write_length(uint8_t* out, uint64_t length) {
+    for(; length >= 255; length -= 255) *out++ = 255;
+    *out++ = length;
+    return out;
+}
+
+static uint8_t* write_sequence(uint8_t* out, const uint8_t* literals, uint64_t literal_count, uint64_t offset, uint64_t match_length) {
+    uint8_t* token = out++;
+    *token = (literal_count < 15 ? literal_count : 15) << 4;
+    if(literal_count >= 15) out = write_length(out, literal_count - 15);
+    memcpy(out, literals, literal_count);
+    out += literal_count;
+    if(match_length == 0) return out; // the last sequence
+    *out++ = offset & 0xff;
+    *out++ = offset >> 8;
+    match_length -= 4;
+    *token |= match_length < 15 ? match_length : 15;
+    if(match_length >= 15) out = write_length(out, match_length - 15);
+    return out;
+}
+
+// greedy: takes the first match of at least 4 bytes that the hash table remembers. out needs room for
+// size + size / 255 + 16 bytes (incompressible data grows a little). returns the compressed size
+static uint64_t compress(const uint8_t* in, uint64_t size, uint8_t* out) {
+    static int64_t table[1 << HASH_BITS];
+    for(int i = 0; i < 1 << HASH_BITS; i++) table[i] = -1;
+    uint8_t* out_start = out;
+    uint64_t anchor = 0;
+    uint64_t position = 0;
+    while(size > MATCH_START_LIMIT && position < size - MATCH_START_LIMIT) {
+        uint32_t hash = hash32(read32(in + position));
+        int64_t candidate = table[hash];
+        table[hash] = position;
+        if(candidate < 0 || position - candidate > 65535 || read32(in + candidate) != read32(in + position)) {
+            position++;
+            continue;
+        }
+        uint64_t length = 4;
+        while(position + length < size - LAST_LITERALS && in[candidate + length] == in[position + length]) length++;
+        out = write_sequence(out, in + anchor, position - anchor, position - candidate, length);
+        position += length;
+        anchor = position;
+    }
+    out = write_sequence(out, in + anchor, size - anchor, 0, 0);
+    return out - out_start;
+}
+
+static void fail(const char* message, const char* path) {
+    fprintf(stderr, "lz4pack: %s: %s\n", path, message);
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    if(argc != 3) {
+        fprintf(stderr, "usage: lz4pack <kernel.elf> <output>\n");
+        return 1;
+    }
+    FILE* file = fopen(argv[1], "rb");
+    if(!file) fail("can't open", argv[1]);
+    fseek(file, 0, SEEK_END);
+    uint64_t elf_size = ftell(file);
+    rewind(file);
+    uint8_t* elf = malloc(elf_size);
+    if(fread(elf, 1, elf_size, file) != elf_size) fail("can't read", argv[1]);
+    fclose(file);
+
+    elf_header header;
+    if(elf_size < sizeof(header)) fail("not an elf file", argv[1]);
+    memcpy(&header, elf, sizeof(header));
+    if(memcmp(header.e_ident, "\x7f" "ELF", 4) || header.e_ident[4] != 2) fail("not a 64 bit elf file", argv[1]);
+    uint64_t headers_size = header.e_phoff + (uint64_t) header.e_phnum * header.e_phentsize;
+    if(headers_size < sizeof(header)) headers_size = sizeof(header);
+    if(headers_size > elf_size) fail("program headers are past the end of the file", argv[1]);
+
+    elf_program_header* program_headers = (elf_program_header*) (elf + header.e_phoff);
+    lz4_container_segment segments[64];
+    uint32_t segment_count = 0;
+    uint64_t blocks_size = 0;
+    uint8_t* blocks = malloc(elf_size + elf_size / 255 + 16 * header.e_phnum);
+    for(int i = 0; i < header.e_phnum; i++) {
+        elf_program_header program_header = program_headers[i];
+        if(program_header.p_type != PT_LOAD || program_header.p_filesz == 0) continue;
+        if(segment_count == 64) fail("too many segments", argv[1]);
+        if(program_header.p_offset + program_header.p_filesz > elf_size) fail("segment is past the end of the file", argv[1]);
+
+        const uint8_t* contents = elf + program_header.p_offset;
+        uint64_t compressed_size = compress(contents, program_header.p_filesz, blocks + blocks_size);
+        uint8_t* check = malloc(program_header.p_filesz);
+        int64_t check_size = lz4_decompress(blocks + blocks_size, compressed_size, check, program_header.p_filesz);
+        if(check_size != (int64_t) program_header.p_filesz || memcmp(check, contents, program_header.p_filesz)) {
+            fail("a compressed segment didn't decompress to the original", argv[1]);
+        }
+        free(check);
+
+        segments[segment_count++] = (lz4_container_segment) { program_header.p_vaddr, program_header.p_filesz, compressed_size };
+        blocks_size += compressed_size;
+    }
+
+    lz4_container_header container = { LZ4_CONTAINER_MAGIC, segment_count, 0, headers_size };
+    container.size = lz4_headersOffset(&container) + headers_size + blocks_size;
+    file = fopen(argv[2], "wb");
+    if(!file) fail("can't create", argv[2]);
+    fwrite(&container, sizeof(container), 1, file);
+    fwrite(segments, sizeof(lz4_container_segment), segment_count, file);
+    fwrite(elf, 1, headers_size, file);
+    fwrite(blocks, 1, blocks_size, file);
+    if(fclose(file)) fail("can't write", argv[2]);
+    printf("lz4pack: %s is %lu bytes, %lu as %s\n", argv[1], (unsigned long) elf_size, (unsigned long) container.size, argv[2]);
+    return 0;
+}